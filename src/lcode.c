@@ -0,0 +1,681 @@
+#include <stdlib.h>
+
+#include "lcode.h"
+#include "lframe.h"
+#include "lgc.h"
+#include "lsym.h"
+#include "lval.h"
+
+// Stack depth while compiling, to size the stack a run needs
+static int depth = 0;
+// Lists being compiled, one inside the next, and whether that passed
+// LVAL_MAX_DEPTH
+static int nesting = 0;
+static int too_deep = 0;
+
+static void lcode_emit(lcode* c, int op) {
+    if (c->count == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 16;
+        c->ops = realloc(c->ops, sizeof(int) * c->cap);
+    }
+    c->ops[c->count++] = op;
+}
+
+static int lcode_const(lcode* c, lval* v) {
+    if (c->nconsts == c->consts_cap) {
+        c->consts_cap = c->consts_cap ? c->consts_cap * 2 : 8;
+        c->consts = realloc(c->consts, sizeof(lval*) * c->consts_cap);
+    }
+    c->consts[c->nconsts] = v;
+    return c->nconsts++;
+}
+
+static void lcode_depth(lcode* c, int n) {
+    depth += n;
+    if (depth > c->max_stack) {
+        c->max_stack = depth;
+    }
+}
+
+/* Special forms compiled in place when they are called by name. At run
+ * time LCODE_SPECIAL checks that the name is still bound to the builtin,
+ * so a rebound name is called like any other function.
+ */
+enum { LFORM_IF, LFORM_AND, LFORM_OR, LFORM_WHEN, LFORM_UNLESS, LFORM_COND };
+
+static struct {
+    char* name;
+    lbuiltin builtin;
+} forms[] = {
+    { "if", builtin_if },
+    { "and", builtin_and },
+    { "or", builtin_or },
+    { "when", builtin_when },
+    { "unless", builtin_unless },
+    { "cond", builtin_cond },
+};
+
+static void lcode_cells(lcode* c, lval* v, int start, int tail);
+
+static void lcode_expr(lcode* c, lval* v) {
+    if (v->type == LVAL_SEXPR) {
+        lcode_cells(c, v, 0, 0);
+        return;
+    }
+    lcode_emit(c, v->type == LVAL_SYM ? LCODE_SYM : LCODE_CONST);
+    lcode_emit(c, lcode_const(c, v));
+    lcode_depth(c, 1);
+}
+
+/* Emit a jump whose target isn't known yet, chaining its operand to the
+ * previous such jump in *chain for lcode_patch to fill in.
+ */
+static void lcode_jump_later(lcode* c, int op, int* chain) {
+    lcode_emit(c, op);
+    lcode_emit(c, *chain);
+    *chain = c->count - 1;
+}
+
+static void lcode_patch(lcode* c, int chain, int target) {
+    while (chain >= 0) {
+        int next = c->ops[chain];
+        c->ops[chain] = target;
+        chain = next;
+    }
+}
+
+/* Pop a condition of form, its operand or clause i, jumping to a target
+ * chained on *chain when its truth is sense.
+ */
+static void lcode_test(lcode* c, int form, int i, int sense, int* chain) {
+    lcode_emit(c, LCODE_TEST);
+    lcode_emit(c, form);
+    lcode_emit(c, i);
+    lcode_emit(c, sense);
+    lcode_emit(c, *chain);
+    *chain = c->count - 1;
+    lcode_depth(c, -1);
+}
+
+/* A branch as lval_eval_branch runs it: one in braces as an S-expression,
+ * anything else evaluated and then, by LCODE_BRANCH, run if its value is
+ * a Q-Expression. That check follows the call, so only a branch in braces
+ * can end in a tail call.
+ */
+static void lcode_branch(lcode* c, lval* v, int tail) {
+    if (v->type == LVAL_QEXPR) {
+        lcode_cells(c, v, 0, tail);
+        return;
+    }
+    lcode_expr(c, v);
+    if (v->type == LVAL_SYM || v->type == LVAL_SEXPR) {
+        lcode_emit(c, LCODE_BRANCH);
+    }
+}
+
+static void lcode_const_num(lcode* c, long n) {
+    // Small numbers are immortal, so code can hold them like body nodes
+    lcode_emit(c, LCODE_CONST);
+    lcode_emit(c, lcode_const(c, lval_num(n)));
+    lcode_depth(c, 1);
+}
+
+/* The form v calls from cell start, if it is one that can be compiled in
+ * place, or -1.
+ */
+static int lcode_form(lval* v, int start) {
+    lval* head = v->cell[start];
+    int n = v->count - start;
+    if (head->type != LVAL_SYM) {
+        return -1;
+    }
+    int form = -1;
+    for (int i = 0; i < (int)(sizeof(forms) / sizeof(forms[0])); i++) {
+        if (head->sym == lsym_intern(forms[i].name)) {
+            form = i;
+        }
+    }
+    switch (form) {
+    case LFORM_IF:
+        return n == 4 ? form : -1;
+    case LFORM_WHEN:
+    case LFORM_UNLESS:
+        // Without a body the value is the condition's, left to the builtin
+        return n >= 3 ? form : -1;
+    case LFORM_COND:
+        for (int i = start + 1; i < v->count; i++) {
+            if (v->cell[i]->type != LVAL_QEXPR || v->cell[i]->count < 2) {
+                return -1;
+            }
+        }
+        return form;
+    }
+    return form;
+}
+
+/* The operands of form v from cell start, leaving its value. Every way
+ * out jumps to a target chained on *end.
+ */
+static void lcode_form_body(lcode* c, int form, lval* v, int start,
+                            int tail, int* end) {
+    lval** ops = v->cell + start + 1;
+    int n = v->count - start - 1;
+    int out = -1;
+    int d = depth;
+
+    switch (form) {
+    case LFORM_IF:
+        lcode_expr(c, ops[0]);
+        lcode_test(c, form, 0, 0, &out);
+        lcode_branch(c, ops[1], tail);
+        lcode_jump_later(c, LCODE_JUMP, end);
+        lcode_patch(c, out, c->count);
+        depth = d;
+        lcode_branch(c, ops[2], tail);
+        break;
+    case LFORM_AND:
+    case LFORM_OR:
+        // and stops at the first false operand, or at the first true one
+        for (int i = 0; i < n; i++) {
+            lcode_expr(c, ops[i]);
+            lcode_test(c, form, i, form == LFORM_OR, &out);
+        }
+        lcode_const_num(c, form == LFORM_AND);
+        lcode_jump_later(c, LCODE_JUMP, end);
+        lcode_patch(c, out, c->count);
+        depth = d;
+        lcode_const_num(c, form == LFORM_OR);
+        break;
+    case LFORM_WHEN:
+    case LFORM_UNLESS:
+        lcode_expr(c, ops[0]);
+        lcode_test(c, form, 0, form == LFORM_UNLESS, &out);
+        for (int i = 1; i < n; i++) {
+            lcode_branch(c, ops[i], tail && i == n - 1);
+            if (i < n - 1) {
+                lcode_emit(c, LCODE_POP);
+                lcode_depth(c, -1);
+            }
+        }
+        lcode_jump_later(c, LCODE_JUMP, end);
+        lcode_patch(c, out, c->count);
+        depth = d;
+        lcode_emit(c, LCODE_APPLY);
+        lcode_emit(c, 0);
+        lcode_depth(c, 1);
+        break;
+    case LFORM_COND:
+        for (int i = 0; i < n; i++) {
+            out = -1;
+            lcode_expr(c, ops[i]->cell[0]);
+            lcode_test(c, form, i, 0, &out);
+            lcode_cells(c, ops[i], 1, tail);
+            lcode_jump_later(c, LCODE_JUMP, end);
+            lcode_patch(c, out, c->count);
+            depth = d;
+        }
+        lcode_emit(c, LCODE_APPLY);
+        lcode_emit(c, 0);
+        lcode_depth(c, 1);
+        break;
+    }
+    lcode_jump_later(c, LCODE_JUMP, end);
+}
+
+/* Evaluate cells start.. of v as an S-expression, leaving its value. In
+ * tail position the application ends the run instead.
+ *
+ * Once the head is evaluated, SPECIAL checks whether it is a special
+ * form. If it is the one compiled in place the run carries on into that
+ * code; another is called on the rest as written; anything else has the
+ * rest evaluated and applied to it.
+ *
+ *     <head> SPECIAL list start form generic end <form> JUMP end
+ *     generic: <rest> APPLY n
+ *     end:
+ */
+static void lcode_cells(lcode* c, lval* v, int start, int tail) {
+    if (nesting == LVAL_MAX_DEPTH) {
+        too_deep = 1;
+        return;
+    }
+    nesting++;
+    int n = v->count - start;
+    if (n > 0) {
+        lcode_expr(c, v->cell[start]);
+    }
+    // A single value is the S-expression's value as it is
+    if (n == 1) {
+        nesting--;
+        return;
+    }
+
+    int end = -1;
+    if (n > 1) {
+        int form = lcode_form(v, start);
+        lcode_emit(c, LCODE_SPECIAL);
+        lcode_emit(c, lcode_const(c, v));
+        lcode_emit(c, start);
+        lcode_emit(c, form);
+        int generic = c->count;
+        lcode_emit(c, 0);
+        lcode_emit(c, end);
+        end = c->count - 1;
+
+        int d = depth;
+        if (form >= 0) {
+            depth = d - 1;
+            lcode_form_body(c, form, v, start, tail, &end);
+        }
+        c->ops[generic] = c->count;
+        depth = d;
+        for (int i = start + 1; i < v->count; i++) {
+            lcode_expr(c, v->cell[i]);
+        }
+    }
+    lcode_emit(c, tail ? LCODE_TAIL : LCODE_APPLY);
+    lcode_emit(c, n);
+    lcode_depth(c, n ? 1 - n : 1);
+    lcode_patch(c, end, c->count);
+    nesting--;
+}
+
+lcode* lcode_compile(lval* body) {
+    lcode* c = calloc(1, sizeof(lcode));
+    c->refs = 1;
+    c->body = body;
+    depth = 0;
+    nesting = 0;
+    too_deep = 0;
+    lcode_cells(c, body, 0, 1);
+    lcode_emit(c, LCODE_RETURN);
+    if (too_deep) {
+        lval_delete(lcode_release(c));
+        return NULL;
+    }
+    return c;
+}
+
+lval* lcode_release(lcode* c) {
+    if (--c->refs > 0) {
+        return NULL;
+    }
+    lval* body = c->body;
+    free(c->ops);
+    free(c->consts);
+    free(c);
+    return body;
+}
+
+/* One value stack shared by every run. Runs nest through lval_call, each
+ * above the last, and the stack may move when a nested run grows it, so
+ * slots are always addressed through stack.
+ */
+static lval** stack = NULL;
+static int stack_count = 0;
+static int stack_cap = 0;
+
+static void lcode_reserve(int n) {
+    if (stack_count + n > stack_cap) {
+        while (stack_count + n > stack_cap) {
+            stack_cap = stack_cap ? stack_cap * 2 : 256;
+        }
+        stack = realloc(stack, sizeof(lval*) * stack_cap);
+    }
+}
+
+static void lcode_unwind(int base) {
+    while (stack_count > base) {
+        lval_delete(stack[--stack_count]);
+    }
+}
+
+/* Pop the top n values and apply them as lval_eval_sexpr applies an
+ * evaluated S-expression.
+ */
+static lval* lcode_apply(lenv* e, int n) {
+    if (n == 0) {
+        return lval_sexpr();
+    }
+    int base = stack_count - n;
+    lval* f = stack[base];
+    if (n == 1) {
+        stack_count = base;
+        return f;
+    }
+    if (f->type != LVAL_FUN) {
+        lval* result;
+        if (f->type != LVAL_SEXPR || f->count) {
+            result = lval_err("S-expression should start with a %s not a %s",
+                              ltype_name(LVAL_FUN), ltype_name(f->type));
+        }
+        else {
+            result = lval_str("ok");
+        }
+        lcode_unwind(base);
+        return result;
+    }
+
+    // A builtin's fast path takes the arguments from the stack, so the call
+    // builds no argument list
+    if (f->builtin && f->arity == n - 1) {
+        lval* result = f->fixed(e, stack + base + 1);
+        if (result) {
+            lcode_unwind(base);
+            return result;
+        }
+    }
+    // Nor does a lambda given exactly its formals: its frame takes the
+    // arguments over, off the stack before the body runs above them
+    if (!f->builtin && f->arity == n - 1 && !f->variadic) {
+        stack_count = base;
+        lval* result = lval_call_args(e, f, stack + base + 1);
+        lval_delete(f);
+        return result;
+    }
+
+    lval* a = lval_reserve(lval_sexpr(), n - 1);
+    for (int i = base + 1; i < stack_count; i++) {
+        lval_add(a, stack[i]);
+    }
+    stack_count = base;
+    lval* result = lval_call(e, f, a);
+    lval_delete(f);
+    return result;
+}
+
+/* Whether f, the value of the head at cell start of list, must be called
+ * on the rest of list as written. Not for if with both branches in
+ * braces: they evaluate to themselves, so evaluating every cell first
+ * changes nothing and lets the branch be run in place.
+ */
+static int lcode_is_special(lval* f, lval* list, int start) {
+    if (f->type != LVAL_FUN || !f->special) {
+        return 0;
+    }
+    lval** v = list->cell + start;
+    return f->builtin != builtin_if || list->count - start != 4 ||
+        v[2]->type != LVAL_QEXPR || v[3]->type != LVAL_QEXPR;
+}
+
+/* Call special form f on the cells of list after its head at cell start.
+ * Consumes f.
+ */
+static lval* lcode_special(lenv* e, lval* f, lval* list, int start) {
+    lval* a = lval_reserve(lval_sexpr(), list->count - start - 1);
+    for (int i = start + 1; i < list->count; i++) {
+        lval_add(a, lval_copy(list->cell[i]));
+    }
+    lval* result = lval_call(e, f, a);
+    lval_delete(f);
+    return result;
+}
+
+/* The list a tail call of the top n values would evaluate: the argument
+ * of eval, or the branch if picks. NULL when it is any other call, or
+ * when the arguments are wrong and the builtin should report it.
+ */
+static lval* lcode_inline_list(int n) {
+    lval** v = stack + stack_count - n;
+    if (v[0]->type != LVAL_FUN) {
+        return NULL;
+    }
+    if (n == 2 && v[0]->builtin == builtin_eval &&
+        v[1]->type == LVAL_QEXPR) {
+        return v[1];
+    }
+    if (n == 4 && v[0]->builtin == builtin_if && v[1]->type == LVAL_NUM &&
+        v[2]->type == LVAL_QEXPR && v[3]->type == LVAL_QEXPR) {
+        return v[1]->num ? v[2] : v[3];
+    }
+    return NULL;
+}
+
+/* Replace the top n values with the evaluated cells of list, returning
+ * how many there are, or -1 with the error in *err.
+ */
+static int lcode_inline(lenv* e, int n, lval* list, lval** err) {
+    int base = stack_count - n;
+    list = lval_copy(list);
+    lcode_unwind(base);
+    lcode_reserve(list->count);
+    for (int i = 0; i < list->count; i++) {
+        lval* x = lval_eval(e, lval_copy(list->cell[i]));
+        if (i == 0 && list->count > 1 && lcode_is_special(x, list, 0)) {
+            x = lcode_special(e, x, list, 0);
+            i = list->count;
+        }
+        if (x->type == LVAL_ERR) {
+            lcode_unwind(base);
+            lval_delete(list);
+            *err = x;
+            return -1;
+        }
+        stack[stack_count++] = x;
+    }
+    n = stack_count - base;
+    lval_delete(list);
+    return n;
+}
+
+/* Bindings carried from a frame dropped by a tail call to the frame that
+ * replaces it (see lcode_carry).
+ */
+static char** carry_syms = NULL;
+static lval** carry_vals = NULL;
+static int carry_cap = 0;
+
+/* Copy the bindings of frame e that a call of g doesn't make itself into
+ * carry, returning how many. Binding them in g's frame lets e be dropped
+ * without changing what g's body sees through the dynamic scope.
+ */
+static int lcode_carry(lenv* e, lval* g) {
+    int n = 0;
+    for (int i = 0; i < e->count; i++) {
+        int bound = 0;
+        for (int j = 0; j < g->env->count && !bound; j++) {
+            bound = g->env->syms[j] == e->syms[i];
+        }
+        for (int j = 0; j < g->formals->count && !bound; j++) {
+            bound = g->formals->cell[j]->sym == e->syms[i];
+        }
+        if (bound) {
+            continue;
+        }
+        if (n == carry_cap) {
+            carry_cap = carry_cap ? carry_cap * 2 : 8;
+            carry_syms = realloc(carry_syms, sizeof(char*) * carry_cap);
+            carry_vals = realloc(carry_vals, sizeof(lval*) * carry_cap);
+        }
+        carry_syms[n] = e->syms[i];
+        carry_vals[n] = lval_copy(e->vals[i]);
+        n++;
+    }
+    return n;
+}
+
+/* Run c in e. frames is how many activation records the run owns: the
+ * innermost is e, each further one its par. A tail call replaces the
+ * caller's frame with its own, carrying over whichever of the caller's
+ * bindings it doesn't make, so the frames a loop needs stay bounded. All
+ * of them are popped before returning.
+ */
+static lval* lcode_exec(lenv* e, lcode* c, int frames) {
+    lcode_reserve(c->max_stack);
+    int base = stack_count;
+    int* pc = c->ops;
+    // Once a tail call switches code, the function it belongs to
+    lval* fn = NULL;
+    lval* x = NULL;
+
+    lgc_enter();
+    for (;;) {
+        switch (*pc++) {
+        case LCODE_CONST:
+            stack[stack_count++] = lval_copy(c->consts[*pc++]);
+            continue;
+        case LCODE_SYM: {
+            // As lval_eval: a resolved formal is an indexed load
+            lval* v = c->consts[*pc++];
+            int s = v->slot;
+            x = (s >= 0 && s < e->count && e->syms[s] == v->sym) ?
+                lval_copy(e->vals[s]) : lenv_get_cached(e, v);
+            break;
+        }
+        case LCODE_APPLY:
+            x = lcode_apply(e, *pc++);
+            break;
+        case LCODE_TAIL: {
+            int n = *pc++;
+            lval* list;
+            while (n >= 2 && (list = lcode_inline_list(n))) {
+                n = lcode_inline(e, n, list, &x);
+                if (n < 0) {
+                    goto done;
+                }
+            }
+
+            lval* g = n >= 2 ? stack[stack_count - n] : NULL;
+            int nargs = n - 1;
+            if (g == NULL || g->type != LVAL_FUN || g->builtin ||
+                g->code == NULL || g->arity < 0 || nargs < g->arity ||
+                (!g->variadic && nargs > g->arity)) {
+                x = lcode_apply(e, n);
+                goto done;
+            }
+
+            // Only a variadic lambda needs its arguments as a list; the
+            // frame takes the rest over from the stack
+            lval** args = stack + stack_count - nargs;
+            lval* a = NULL;
+            if (g->variadic) {
+                a = lval_reserve(lval_sexpr(), nargs);
+                for (int i = 0; i < nargs; i++) {
+                    lval_add(a, args[i]);
+                }
+            }
+            stack_count -= n;
+
+            lenv* par = e;
+            int carried = 0;
+            if (frames) {
+                carried = lcode_carry(e, g);
+                par = e->par;
+                lframe_pop(e);
+                frames--;
+            }
+            e = a ? lval_bind_frame(par, g, a, carried) :
+                lval_push_frame(par, g, args, carried);
+            for (int i = 0; i < carried; i++) {
+                lenv_bind(e, carry_syms[i], carry_vals[i]);
+            }
+            frames++;
+
+            if (fn) {
+                lval_delete(fn);
+            }
+            fn = g;
+            c = g->code;
+            lcode_reserve(c->max_stack);
+            pc = c->ops;
+            continue;
+        }
+        case LCODE_SPECIAL: {
+            // list start form generic end
+            lval* f = stack[stack_count - 1];
+            if (f->type != LVAL_FUN || !f->special) {
+                pc = c->ops + pc[3];
+                continue;
+            }
+            if (pc[2] >= 0 && f->builtin == forms[pc[2]].builtin) {
+                stack_count--;
+                lval_delete(f);
+                pc += 5;
+                continue;
+            }
+            lval* list = c->consts[pc[0]];
+            if (!lcode_is_special(f, list, pc[1])) {
+                pc = c->ops + pc[3];
+                continue;
+            }
+            stack_count--;
+            x = lcode_special(e, f, list, pc[1]);
+            pc = c->ops + pc[4];
+            break;
+        }
+        case LCODE_TEST: {
+            // form i sense target
+            lval* v = stack[--stack_count];
+            if (v->type != LVAL_NUM) {
+                x = lval_cond_err(forms[pc[0]].builtin, pc[1], v->type);
+                lval_delete(v);
+                break;
+            }
+            pc = (v->num != 0) == pc[2] ? c->ops + pc[3] : pc + 4;
+            lval_delete(v);
+            continue;
+        }
+        case LCODE_BRANCH: {
+            // A branch's value, run in turn when it is a Q-Expression
+            lval* v = stack[stack_count - 1];
+            if (v->type != LVAL_QEXPR) {
+                continue;
+            }
+            stack_count--;
+            v = lval_unshare(v);
+            v->type = LVAL_SEXPR;
+            x = lval_eval(e, v);
+            break;
+        }
+        case LCODE_POP:
+            lval_delete(stack[--stack_count]);
+            continue;
+        case LCODE_JUMP:
+            pc = c->ops + *pc;
+            continue;
+        case LCODE_RETURN:
+            x = stack[--stack_count];
+            goto done;
+        }
+
+        // An error is the value of every S-expression enclosing it, and so
+        // of the whole body
+        if (x->type == LVAL_ERR) {
+            lcode_unwind(base);
+            goto done;
+        }
+        stack[stack_count++] = x;
+    }
+
+done:
+    while (frames--) {
+        lenv* par = e->par;
+        lframe_pop(e);
+        e = par;
+    }
+    if (fn) {
+        lval_delete(fn);
+    }
+    lgc_leave();
+    return x;
+}
+
+lval* lcode_run(lenv* e, lcode* c) {
+    return lcode_exec(e, c, 0);
+}
+
+lval* lcode_run_frame(lenv* frame, lcode* c) {
+    return lcode_exec(frame, c, 1);
+}
+
+void lcode_destroy(void) {
+    free(carry_syms);
+    free(carry_vals);
+    carry_syms = NULL;
+    carry_vals = NULL;
+    carry_cap = 0;
+    free(stack);
+    stack = NULL;
+    stack_count = 0;
+    stack_cap = 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+typedef struct lval lval;
+typedef struct lenv lenv;
+
+/* Lambda bodies compiled to bytecode for a small stack machine.
+ *
+ * lcode_compile turns a body into a flat sequence of instructions that
+ * pushes constants and variables, applies the values on top of the stack
+ * the way lval_eval_sexpr applies an evaluated S-expression, and jumps
+ * around the operands of special forms. Running it needs no copy of the
+ * body and builds no intermediate S-expressions, only the argument lists
+ * handed to builtins without a fast path and to variadic or partially
+ * applied lambdas. Any other lambda binds its arguments straight off the
+ * stack.
+ *
+ * Compiling recurses on the C stack, so a body whose lists nest deeper
+ * than LVAL_MAX_DEPTH is not compiled and is left to the interpreter.
+ *
+ * Code holds the body it was compiled from and borrows its constants from
+ * it. That body is the lambda's with constants inlined (see
+ * lval_inline_consts), so it may differ from the one the lambda prints.
+ * Code is shared between copies of a lambda by reference count; dropping
+ * the last reference hands the body back for the caller to release.
+ *
+ * Every application checks its head with LCODE_SPECIAL before the rest is
+ * evaluated. if, and, or, when, unless and cond called by name are
+ * compiled in place, their conditions checked by LCODE_TEST and their
+ * branches run as the body's own code, so they copy nothing either. A
+ * branch not in braces is followed by LCODE_BRANCH, which runs its value
+ * when that is a Q-Expression. Any other special form (see
+ * lenv_add_special) is called on the rest as written.
+ *
+ * An application in tail position, the last thing a body or a branch
+ * does, is LCODE_TAIL. When it calls a lambda the run switches to the
+ * lambda's code in a fresh frame rather than recursing, and when it calls
+ * eval, or if with its branch known, the list is evaluated in place as if
+ * written there, so loops written as recursion run in constant C stack.
+ */
+enum { LCODE_CONST, LCODE_SYM, LCODE_APPLY, LCODE_TAIL, LCODE_SPECIAL,
+       LCODE_TEST, LCODE_BRANCH, LCODE_POP, LCODE_JUMP, LCODE_RETURN };
+
+typedef struct lcode {
+    int refs;
+    // The body compiled, owned by the code
+    lval* body;
+    // Instructions, each an opcode followed by its operands
+    int* ops;
+    int count;
+    int cap;
+    // Nodes of the body referenced by LCODE_CONST and LCODE_SYM
+    lval** consts;
+    int nconsts;
+    int consts_cap;
+    // Most values the code ever has on the stack at once
+    int max_stack;
+} lcode;
+
+lcode* lcode_compile(lval* body);
+lval* lcode_release(lcode* c);
+lval* lcode_run(lenv* e, lcode* c);
+lval* lcode_run_frame(lenv* frame, lcode* c);
+void lcode_destroy(void);
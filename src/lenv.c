@@ -1,47 +1,229 @@
+#include <stdint.h>
+
 #include "lenv.h"
 #include "lval.h"
+#include "lgc.h"
+#include "lmod.h"
+#include "lpool.h"
+#include "lsym.h"
+
+static lenv_stats stats;
+
+/* Inline caches on symbol nodes remember the frame and slot a reference
+ * was found in. A name bound exactly once anywhere can only resolve to
+ * that binding, so while lsym binds is 1 the cache is good as long as the
+ * frame it points at is alive and on the lookup chain. Freeing such a
+ * frame bumps lenv_version, invalidating every cache at once. So do
+ * creating and deleting a fork, whose chain leaves out live frames.
+ */
+static unsigned long lenv_version = 1;
+
+lenv_stats* lenv_get_stats(void) {
+    return &stats;
+}
+
+/* Heap bytes behind e's tables; an activation record's own arrays are on
+ * the interpreter stack and not counted.
+ */
+static unsigned long lenv_table_bytes(lenv* e) {
+    unsigned long n = sizeof(int) * e->index_cap;
+    if (!e->on_stack) {
+        n += (sizeof(char*) + sizeof(lval*)) * e->cap;
+    }
+    if (e->consts) {
+        n += e->cap;
+    }
+    return n;
+}
+
+static void lenv_count_bytes(unsigned long before, unsigned long after) {
+    stats.bytes += after - before;
+    if (stats.bytes > stats.max_bytes) {
+        stats.max_bytes = stats.bytes;
+    }
+}
+
+void lenv_print_stats(void) {
+    unsigned long searched = stats.lookups - stats.cache_hits;
+    printf("env: %lu lookups, %lu cache hits, %lu misses\n",
+           stats.lookups, stats.cache_hits, stats.misses);
+    printf("env: %.2f frames searched per lookup, %lu at most\n",
+           searched ? (double)stats.frames_walked / searched : 0.0,
+           stats.max_depth);
+    printf("env: %lu puts, %lu new bindings\n", stats.puts, stats.binds);
+    printf("env: %lu frames freed, %.2f bindings on average, %lu at most\n",
+           stats.frames_freed,
+           stats.frames_freed ?
+           (double)stats.frame_bindings / stats.frames_freed : 0.0,
+           stats.max_frame);
+    printf("env: %lu bytes in binding tables, %lu at most\n",
+           stats.bytes, stats.max_bytes);
+}
 
 lenv* lenv_new(void) {
-    lenv* e = malloc(sizeof(lenv));
+    lenv* e = lpool_alloc(sizeof(lenv));
     e->par = NULL;
+    e->refs = 1;
     e->count = 0;
+    e->cap = 0;
     e->syms = NULL;
     e->vals = NULL;
+    e->index = NULL;
+    e->index_cap = 0;
+    e->cached = 0;
+    e->on_stack = 0;
+    e->name = NULL;
+    e->consts = NULL;
+    e->proto = NULL;
+    lgc_track_env(e);
     return e;
 }
 
 void lenv_delete(lenv* e) {
+    if (--e->refs > 0) {
+        return;
+    }
     for (int i = 0; i < e->count; i++) {
-        free(e->syms[i]);
         lval_delete(e->vals[i]);
     }
-    free(e->syms);
-    free(e->vals);
-    free(e);
+    lenv_free_tables(e);
+    if (e->proto) {
+        lenv_version++;
+        lenv_delete(e->proto);
+    }
+    lgc_untrack_env(e);
+    lpool_free(e, sizeof(lenv));
+}
+
+static void lenv_index_insert(lenv* e, int slot) {
+    unsigned long mask = e->index_cap - 1;
+    unsigned long i = lsym_of(e->syms[slot])->hash & mask;
+    while (e->index[i]) {
+        i = (i + 1) & mask;
+    }
+    e->index[i] = slot + 1;
+}
+
+static void lenv_reindex(lenv* e, int index_cap) {
+    free(e->index);
+    e->index_cap = index_cap;
+    e->index = calloc(index_cap, sizeof(int));
+    for (int i = 0; i < e->count; i++) {
+        lenv_index_insert(e, i);
+    }
+}
+
+/* The slot holding sym in this frame only, or -1. */
+static int lenv_find(lenv* e, char* sym) {
+    if (e->index == NULL) {
+        for (int i = 0; i < e->count; i++) {
+            if (sym == e->syms[i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    unsigned long mask = e->index_cap - 1;
+    unsigned long i = lsym_of(sym)->hash & mask;
+    while (e->index[i]) {
+        int slot = e->index[i] - 1;
+        if (e->syms[slot] == sym) {
+            return slot;
+        }
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+/* The frame binding sym as seen from e, searching each frame's own
+ * bindings, then those it was forked from, then its parent. */
+static lenv* lenv_lookup(lenv* e, char* sym, int* slot) {
+    unsigned long depth = 0;
+    lenv* found = NULL;
+    for (; e && !found; e = e->par) {
+        for (lenv* p = e; p; p = p->proto) {
+            depth++;
+            *slot = lenv_find(p, sym);
+            if (*slot >= 0) {
+                found = p;
+                break;
+            }
+        }
+    }
+
+    stats.frames_walked += depth;
+    if (depth > stats.max_depth) {
+        stats.max_depth = depth;
+    }
+    if (found == NULL) {
+        stats.misses++;
+    }
+    return found;
 }
 
 lval* lenv_get(lenv* e, lval* k) {
     LASSERT(k, (k->type == LVAL_SYM),
             "Getting a sym from environment with wrong type");
-    for (int i = 0; i < e->count; i++) {
-        if (strcmp(k->sym, e->syms[i]) == 0) {
-            return lval_copy(e->vals[i]);
-        }
+    stats.lookups++;
+    int slot;
+    lenv* f = lenv_lookup(e, k->sym, &slot);
+    if (f) {
+        return lval_copy(f->vals[slot]);
     }
-    if (e->par) {
-        return lenv_get(e->par, k);
+    return lval_err("unbound symbol: %s", k->sym);
+}
+
+lval* lenv_get_cached(lenv* e, lval* k) {
+    stats.lookups++;
+    if (k->ic_version == lenv_version && lsym_of(k->sym)->binds == 1) {
+        stats.cache_hits++;
+        return lval_copy(k->ic_env->vals[k->ic_slot]);
+    }
+    int slot;
+    lenv* f = lenv_lookup(e, k->sym, &slot);
+    if (f) {
+        f->cached = 1;
+        k->ic_env = f;
+        k->ic_slot = slot;
+        k->ic_version = lenv_version;
+        return lval_copy(f->vals[slot]);
     }
     return lval_err("unbound symbol: %s", k->sym);
 }
 
+/* Unbind every name in e and free its tables. The values are left to the
+ * caller.
+ */
+void lenv_free_tables(lenv* e) {
+    stats.frames_freed++;
+    stats.frame_bindings += e->count;
+    if ((unsigned long)e->count > stats.max_frame) {
+        stats.max_frame = e->count;
+    }
+    stats.bytes -= lenv_table_bytes(e);
+
+    for (int i = 0; i < e->count; i++) {
+        lsym_of(e->syms[i])->binds--;
+    }
+    if (e->cached) {
+        lenv_version++;
+    }
+    if (!e->on_stack) {
+        free(e->syms);
+        free(e->vals);
+    }
+    free(e->consts);
+    free(e->index);
+}
+
 lval* lenv_lookup_sym(lenv* e, lval* v) {
     LASSERT(v, (v->type == LVAL_FUN),
             "Looking up the sym from env with wrong type.");
     for (int i = 0; i < e->count; i++) {
-        if (v->builtin == e->vals[i]->builtin) {
-            char* sym_name = malloc(strlen(e->syms[i]) + 1);
-            strcpy(sym_name, e->syms[i]);
-            return lval_sym(sym_name);
+        if (e->vals[i]->type == LVAL_FUN &&
+            v->builtin == e->vals[i]->builtin) {
+            return lval_sym(e->syms[i]);
         }
     }
     return lval_err("Function is not bound to a symbol");
@@ -51,20 +233,62 @@ void lenv_put(lenv* e, lval* k, lval* v) {
     if (k->type != LVAL_SYM) {
         return;
     }
-    for (int i = 0; i < e->count; i++) {
-        if (strcmp(k->sym, e->syms[i]) == 0) {
-            lval_delete(e->vals[i]);
-            e->vals[i] = lval_copy(v);
+    stats.puts++;
+    int slot = lenv_find(e, k->sym);
+    if (slot >= 0) {
+        if (e->consts && e->consts[slot]) {
             return;
         }
+        lval* old = e->vals[slot];
+        e->vals[slot] = lval_copy(v);
+        lval_delete(old);
+        return;
+    }
+    lenv_bind(e, k->sym, lval_copy(v));
+}
+
+/* Add a binding for a name not yet bound in e, taking ownership of v. */
+void lenv_bind(lenv* e, char* sym, lval* v) {
+    unsigned long before = lenv_table_bytes(e);
+    stats.binds++;
+    if (e->count == e->cap) {
+        e->cap = e->cap ? e->cap * 2 : 4;
+        if (e->on_stack) {
+            // An activation record can't grow in place; move to the heap
+            char** syms = malloc(sizeof(char*) * e->cap);
+            lval** vals = malloc(sizeof(lval*) * e->cap);
+            memcpy(syms, e->syms, sizeof(char*) * e->count);
+            memcpy(vals, e->vals, sizeof(lval*) * e->count);
+            e->syms = syms;
+            e->vals = vals;
+            e->on_stack = 0;
+        }
+        else {
+            e->vals = realloc(e->vals, sizeof(lval*) * e->cap);
+            e->syms = realloc(e->syms, sizeof(char*) * e->cap);
+        }
+        if (e->consts) {
+            e->consts = realloc(e->consts, e->cap);
+        }
     }
+    if (e->consts) {
+        e->consts[e->count] = 0;
+    }
+    e->vals[e->count] = v;
+    e->syms[e->count] = sym;
     e->count++;
-    e->vals = realloc(e->vals, sizeof(lval*) * e->count);
-    e->syms = realloc(e->syms, sizeof(char*) * e->count);
+    lsym_of(sym)->binds++;
 
-    e->vals[e->count - 1] = lval_copy(v);
-    e->syms[e->count - 1] = malloc(strlen(k->sym) + 1);
-    strcpy(e->syms[e->count - 1], k->sym);
+    if (e->count > LENV_LINEAR_MAX) {
+        // Keep the load factor under 1/2
+        if (e->count * 2 > e->index_cap) {
+            lenv_reindex(e, e->index_cap ? e->index_cap * 2 : 32);
+        }
+        else {
+            lenv_index_insert(e, e->count - 1);
+        }
+    }
+    lenv_count_bytes(before, lenv_table_bytes(e));
 }
 
 void lenv_def(lenv* e, lval* k, lval* v) {
@@ -74,37 +298,201 @@ void lenv_def(lenv* e, lval* k, lval* v) {
     lenv_put(e, k, v);
 }
 
+/* Bind k in the root environment of e, flagged as given in consts (0 for
+ * a plain binding), replacing whatever k was bound to there before.
+ */
+static void lenv_def_flagged(lenv* e, lval* k, lval* v, unsigned char flag) {
+    while (e->par) {
+        e = e->par;
+    }
+    int slot = lenv_find(e, k->sym);
+    if (slot >= 0 && e->consts) {
+        e->consts[slot] = 0;
+    }
+    lenv_put(e, k, v);
+    if (flag == 0) {
+        return;
+    }
+    if (e->consts == NULL) {
+        e->consts = calloc(e->cap, 1);
+        lenv_count_bytes(0, e->cap);
+    }
+    e->consts[lenv_find(e, k->sym)] = flag;
+}
+
+/* Bind k in the root environment for good. Callers check the name isn't
+ * already a constant.
+ */
+void lenv_def_const(lenv* e, lval* k, lval* v) {
+    lenv_def_flagged(e, k, v, LENV_CONST);
+}
+
+/* Bind one of a module's exports in the root environment, as a constant
+ * if the module defined it with defconst. Callers check the name isn't a
+ * constant of e's own (see lenv_is_const); one an earlier import bound is
+ * replaced, so that reloading a module updates its constants.
+ */
+void lenv_def_import(lenv* e, lval* k, lval* v, int constant) {
+    lenv_def_flagged(e, k, v, constant ? LENV_IMPORTED : 0);
+}
+
+/* Whether def would find sym a constant: its binding in the root of e, or
+ * failing that in what the root was forked from, was made with defconst
+ * (LENV_CONST) or imported as one (LENV_IMPORTED). 0 if it wasn't.
+ */
+int lenv_is_const(lenv* e, char* sym) {
+    while (e->par) {
+        e = e->par;
+    }
+    for (; e; e = e->proto) {
+        int slot = lenv_find(e, sym);
+        if (slot >= 0) {
+            return e->consts ? e->consts[slot] : 0;
+        }
+    }
+    return 0;
+}
+
 void lenv_print(lenv* e) {
     for (int i = 0; i < e->count; i++) {
-        char* sym_name = malloc(strlen(e->syms[i]) + 1);
-        strcpy(sym_name, e->syms[i]);
-        lval_print(e, lval_sym(sym_name));
-        printf(": %s\t=>\t", ltype_name(e->vals[i]->type));
+        printf("%s", e->syms[i]);
+        printf(": %s%s\t=>\t", e->consts && e->consts[i] ? "const " : "",
+               ltype_name(e->vals[i]->type));
         lval_print(e, e->vals[i]);
         putchar('\n');
     }
 }
 
 lenv* lenv_copy(lenv* e) {
-    lenv* n = malloc(sizeof(lenv));
+    lenv* n = lenv_new();
     n->count = e->count;
+    n->cap = e->count;
     n->par = e->par;
+    n->name = e->name;
+    n->proto = e->proto;
+    if (n->proto) {
+        n->proto->refs++;
+    }
+    if (e->count == 0) {
+        return n;
+    }
+    if (e->consts) {
+        n->consts = malloc(e->count);
+        memcpy(n->consts, e->consts, e->count);
+    }
 
     n->syms = malloc(sizeof(char*) * e->count);
     n->vals = malloc(sizeof(lval*) * e->count);
     for (int i = 0; i < e->count; i++) {
         n->vals[i] = lval_copy(e->vals[i]);
-
-        n->syms[i] = malloc(strlen(e->syms[i]) + 1);
-        strcpy(n->syms[i], e->syms[i]);
+        n->syms[i] = e->syms[i];
+        lsym_of(e->syms[i])->binds++;
+    }
+    if (e->index) {
+        // Slots are unchanged, so the index carries over as is
+        n->index_cap = e->index_cap;
+        n->index = malloc(sizeof(int) * e->index_cap);
+        memcpy(n->index, e->index, sizeof(int) * e->index_cap);
     }
+    lenv_count_bytes(0, lenv_table_bytes(n));
+
+    return n;
+}
 
+/* A new root environment that sees every binding of e without copying
+ * any. Bindings made in the fork, including def, stay in the fork and
+ * shadow e's; e itself is never written through it. Deleting the fork
+ * frees only what was bound in it.
+ */
+lenv* lenv_fork(lenv* e) {
+    lenv* n = lenv_new();
+    n->proto = e;
+    e->refs++;
+    lenv_version++;
     return n;
 }
 
+lenv* lenv_unshare(lenv* e) {
+    if (e->refs == 1) {
+        return e;
+    }
+    e->refs--;
+    return lenv_copy(e);
+}
+
+/* Names of builtins by function pointer, so printing a function never has
+ * to search an environment. Open addressed; filled by lenv_add_builtin and
+ * never emptied, since the names are string literals.
+ */
+static lbuiltin builtin_funcs[LENV_BUILTIN_SLOTS];
+static char* builtin_names[LENV_BUILTIN_SLOTS];
+
+static unsigned long lenv_builtin_hash(lbuiltin func) {
+    return ((uintptr_t)func >> 4) * 2654435761UL;
+}
+
+static void lenv_register_builtin(char* name, lbuiltin func) {
+    unsigned long mask = LENV_BUILTIN_SLOTS - 1;
+    unsigned long i = lenv_builtin_hash(func) & mask;
+    for (int n = 0; n < LENV_BUILTIN_SLOTS; n++, i = (i + 1) & mask) {
+        if (builtin_funcs[i] == func) {
+            return;
+        }
+        if (builtin_funcs[i] == NULL) {
+            builtin_funcs[i] = func;
+            builtin_names[i] = name;
+            return;
+        }
+    }
+}
+
+char* lenv_builtin_name(lbuiltin func) {
+    unsigned long mask = LENV_BUILTIN_SLOTS - 1;
+    unsigned long i = lenv_builtin_hash(func) & mask;
+    for (int n = 0; n < LENV_BUILTIN_SLOTS && builtin_funcs[i];
+         n++, i = (i + 1) & mask) {
+        if (builtin_funcs[i] == func) {
+            return builtin_names[i];
+        }
+    }
+    return NULL;
+}
+
 void lenv_add_builtin(lenv* e, char* name, lbuiltin func) {
+    lenv_register_builtin(name, func);
+    lval* k = lval_sym(name);
+    lval* v = lval_fun(func);
+
+    lenv_put(e, k, v);
+    lval_delete(k);
+    lval_delete(v);
+}
+
+/* Add a builtin called with its operands as written rather than
+ * evaluated, for forms like if that decide what to evaluate.
+ */
+void lenv_add_special(lenv* e, char* name, lbuiltin func) {
+    lenv_register_builtin(name, func);
+    lval* k = lval_sym(name);
+    lval* v = lval_fun(func);
+    v->special = 1;
+
+    lenv_put(e, k, v);
+    lval_delete(k);
+    lval_delete(v);
+}
+
+/* Add a builtin whose calls with exactly arity arguments go to fixed,
+ * which is handed them in place rather than packed into an S-expression.
+ * Other calls, and those fixed declines by returning NULL, go to func.
+ */
+void lenv_add_fixed(lenv* e, char* name, lbuiltin func, lfixed fixed,
+                    int arity) {
+    lenv_register_builtin(name, func);
     lval* k = lval_sym(name);
     lval* v = lval_fun(func);
+    v->fixed = fixed;
+    v->arity = arity;
 
     lenv_put(e, k, v);
     lval_delete(k);
@@ -113,34 +501,48 @@ void lenv_add_builtin(lenv* e, char* name, lbuiltin func) {
 
 void lenv_add_builtins(lenv* e) {
     lenv_add_builtin(e, "list", builtin_list);
-    lenv_add_builtin(e, "head", builtin_head);
-    lenv_add_builtin(e, "tail", builtin_tail);
+    lenv_add_fixed(e, "head", builtin_head, fixed_head, 1);
+    lenv_add_fixed(e, "tail", builtin_tail, fixed_tail, 1);
     lenv_add_builtin(e, "eval", builtin_eval);
     lenv_add_builtin(e, "join", builtin_join);
     lenv_add_builtin(e, "cons", builtin_cons);
-    lenv_add_builtin(e, "len", builtin_len);
+    lenv_add_fixed(e, "len", builtin_len, fixed_len, 1);
     lenv_add_builtin(e, "init", builtin_init);
+    lenv_add_builtin(e, "clist", builtin_clist);
     lenv_add_builtin(e, "def", builtin_def);
+    lenv_add_builtin(e, "defconst", builtin_defconst);
     lenv_add_builtin(e, "=", builtin_put);
     lenv_add_builtin(e, "\\", builtin_lambda);
     lenv_add_builtin(e, "fun", builtin_fun);
-    lenv_add_builtin(e, "<", builtin_lt);
+    lenv_add_fixed(e, "<", builtin_lt, fixed_lt, 2);
     lenv_add_builtin(e, ">", builtin_gt);
     lenv_add_builtin(e, "<=", builtin_le);
     lenv_add_builtin(e, ">=", builtin_ge);
-    lenv_add_builtin(e, "==", builtin_eq);
+    lenv_add_fixed(e, "==", builtin_eq, fixed_eq, 2);
     lenv_add_builtin(e, "!=", builtin_ne);
-    lenv_add_builtin(e, "if", builtin_if);
-    lenv_add_builtin(e, "or", builtin_or);
-    lenv_add_builtin(e, "and", builtin_and);
-    lenv_add_builtin(e, "not", builtin_not);
+    lenv_add_special(e, "if", builtin_if);
+    lenv_add_special(e, "or", builtin_or);
+    lenv_add_special(e, "and", builtin_and);
+    lenv_add_special(e, "cond", builtin_cond);
+    lenv_add_special(e, "when", builtin_when);
+    lenv_add_special(e, "unless", builtin_unless);
+    lenv_add_fixed(e, "not", builtin_not, fixed_not, 1);
     lenv_add_builtin(e, "load", builtin_load);
+    lenv_add_builtin(e, "import", builtin_import);
+    lenv_add_builtin(e, "sandbox", builtin_sandbox);
     lenv_add_builtin(e, "print", builtin_print);
     lenv_add_builtin(e, "error", builtin_error);
+    lenv_add_builtin(e, "alloc-stats", builtin_alloc_stats);
+    lenv_add_builtin(e, "env-stats", builtin_env_stats);
 
-    lenv_add_builtin(e, "+", builtin_add);
-    lenv_add_builtin(e, "-", builtin_sub);
+    lenv_add_fixed(e, "+", builtin_add, fixed_add, 2);
+    lenv_add_fixed(e, "-", builtin_sub, fixed_sub, 2);
     lenv_add_builtin(e, "*", builtin_mul);
     lenv_add_builtin(e, "/", builtin_div);
     lenv_add_builtin(e, "mod", builtin_modulo);
+
+    // The empty Cons-List, so lists can be built up with cons from nothing
+    lval* k = lval_sym("nil");
+    lenv_put(e, k, lval_nil());
+    lval_delete(k);
 }
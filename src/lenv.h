@@ -1,21 +1,102 @@
 #pragma once
+#include "../config.h"
 typedef struct lval lval;
 typedef struct lenv lenv;
+typedef lval*(*lbuiltin)(lenv*, lval*);
+// A builtin's fast path, given its arguments in place (see lenv_add_fixed)
+typedef lval*(*lfixed)(lenv*, lval**);
+/* Frames with at most this many bindings are searched linearly; larger
+ * ones (in practice the global environment) also keep a hash index.
+ */
+#define LENV_LINEAR_MAX 8
+
+// Slots in the builtin name registry, a power of two
+#define LENV_BUILTIN_SLOTS 128
+
+// Flags in lenv.consts
+#define LENV_CONST 1
+#define LENV_IMPORTED 2
+
 struct lenv {
     lenv* par;
+    // Lambdas share their captured frame until one of them binds into it,
+    // see lenv_unshare
+    int refs;
     int count;
+    int cap;
+    // Interned names (see lsym.h), compared by pointer. Bindings are kept
+    // dense and in definition order; slot i is syms[i]/vals[i].
     char** syms;
     lval** vals;
+    // Open addressed table of slot + 1 (0 is empty), keyed on the symbol's
+    // intern hash. NULL until count passes LENV_LINEAR_MAX.
+    int* index;
+    int index_cap;
+    // Set once an inline cache points into this frame
+    int cached;
+    // syms and vals live in an activation record (see lframe.h)
+    int on_stack;
+    // For a lambda's frame, the name fun or def first bound it under
+    char* name;
+    // Per slot, LENV_CONST for bindings made by defconst and LENV_IMPORTED
+    // for constants bound by import, else 0. NULL until the first.
+    unsigned char* consts;
+    // Environment this one was forked from, searched after its own
+    // bindings (see lenv_fork)
+    lenv* proto;
+
+#ifdef LISPY_GC
+    // Tracing collector bookkeeping, see lgc.c
+    lenv* gc_prev;
+    lenv* gc_next;
+    int gc_mark;
+#endif
 };
 
+/* Counters kept by lenv_get, lenv_get_cached and lenv_put, printed by
+ * env-stats and by lispy --env-stats on exit.
+ */
+typedef struct lenv_stats {
+    unsigned long lookups;
+    // Lookups answered by a symbol's inline cache without a search
+    unsigned long cache_hits;
+    unsigned long misses;
+    // Frames searched by the lookups that did search, and the most any
+    // single lookup searched
+    unsigned long frames_walked;
+    unsigned long max_depth;
+
+    unsigned long puts;
+    unsigned long binds;
+    // Sizes of frames when they are freed
+    unsigned long frames_freed;
+    unsigned long frame_bindings;
+    unsigned long max_frame;
+    // Bytes held by binding tables now, and at most
+    unsigned long bytes;
+    unsigned long max_bytes;
+} lenv_stats;
+
+lenv_stats* lenv_get_stats(void);
+void lenv_print_stats(void);
+
 void lenv_delete(lenv* e);
 lenv* lenv_new(void);
 
 lval* lenv_get(lenv* e, lval* k);
+lval* lenv_get_cached(lenv* e, lval* k);
 void lenv_put(lenv* e, lval* k, lval* v);
+void lenv_bind(lenv* e, char* sym, lval* v);
 void lenv_def(lenv* e, lval* k, lval* v);
+void lenv_def_const(lenv* e, lval* k, lval* v);
+void lenv_def_import(lenv* e, lval* k, lval* v, int constant);
+int lenv_is_const(lenv* e, char* sym);
 lenv* lenv_copy(lenv* e);
+lenv* lenv_unshare(lenv* e);
+lenv* lenv_fork(lenv* e);
+void lenv_free_tables(lenv* e);
 
 void lenv_add_builtins(lenv* e);
+char* lenv_builtin_name(lbuiltin func);
 lval* lenv_lookup_sym(lenv* e, lval* v);
 void lenv_print(lenv* e);
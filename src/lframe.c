@@ -0,0 +1,91 @@
+#include <stdlib.h>
+
+#include "lframe.h"
+#include "lenv.h"
+#include "lval.h"
+
+static lframe_chunk* top = NULL;
+static size_t depth = 0;
+
+static lframe_chunk* lframe_chunk_new(lframe_chunk* prev, size_t cap) {
+    lframe_chunk* c = malloc(sizeof(lframe_chunk) + cap);
+    c->prev = prev;
+    c->next = NULL;
+    c->used = 0;
+    c->cap = cap;
+    c->data = (char*)(c + 1);
+    return c;
+}
+
+lenv* lframe_push(lenv* par, int nslots) {
+    size_t size = sizeof(lenv) + 2 * sizeof(void*) * nslots;
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    if (top == NULL) {
+        top = lframe_chunk_new(NULL, LFRAME_CHUNK_BYTES);
+    }
+    if (top->used + size > top->cap) {
+        // Spilled chunks are kept for the next time the stack gets this deep
+        if (top->next == NULL || top->next->cap < size) {
+            lframe_chunk* next = top->next;
+            top->next = lframe_chunk_new(top, size > LFRAME_CHUNK_BYTES ?
+                                         size : LFRAME_CHUNK_BYTES);
+            top->next->next = next;
+            if (next) {
+                next->prev = top->next;
+            }
+        }
+        top = top->next;
+    }
+
+    lenv* e = (lenv*)(top->data + top->used);
+    top->used += size;
+    depth++;
+
+    e->par = par;
+    e->refs = 1;
+    e->count = 0;
+    e->cap = nslots;
+    e->syms = (char**)(e + 1);
+    e->vals = (lval**)(e->syms + nslots);
+    e->index = NULL;
+    e->index_cap = 0;
+    e->cached = 0;
+    e->on_stack = 1;
+    e->name = NULL;
+    e->consts = NULL;
+    e->proto = NULL;
+    return e;
+}
+
+void lframe_pop(lenv* e) {
+    for (int i = 0; i < e->count; i++) {
+        lval_delete(e->vals[i]);
+    }
+    lenv_free_tables(e);
+
+    top->used = (char*)e - top->data;
+    if (top->used == 0 && top->prev) {
+        top = top->prev;
+    }
+    depth--;
+}
+
+size_t lframe_depth(void) {
+    return depth;
+}
+
+void lframe_destroy(void) {
+    if (top == NULL) {
+        return;
+    }
+    while (top->prev) {
+        top = top->prev;
+    }
+    while (top) {
+        lframe_chunk* next = top->next;
+        free(top);
+        top = next;
+    }
+    depth = 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+
+typedef struct lenv lenv;
+
+/* Activation records for saturated lambda calls. Each record is an lenv
+ * whose syms and vals arrays follow it in the same block, bump-allocated
+ * from a chunked stack owned by the interpreter, so a call binds its
+ * arguments without touching the heap. Records are strictly LIFO: the
+ * frame returned by lframe_push must be the next one popped. Chunks are
+ * never moved, so pointers to live frames (such as par) stay valid.
+ */
+#define LFRAME_CHUNK_BYTES 65536
+
+typedef struct lframe_chunk lframe_chunk;
+struct lframe_chunk {
+    lframe_chunk* prev;
+    lframe_chunk* next;
+    size_t used;
+    size_t cap;
+    // Records start here, each aligned to sizeof(void*)
+    char* data;
+};
+
+lenv* lframe_push(lenv* par, int nslots);
+void lframe_pop(lenv* e);
+size_t lframe_depth(void);
+void lframe_destroy(void);
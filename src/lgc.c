@@ -0,0 +1,317 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lgc.h"
+#include "lval.h"
+#include "lcode.h"
+#include "lenv.h"
+#include "lpool.h"
+
+#ifdef LISPY_GC
+
+// Every pool-allocated lval and lenv, linked through their gc_ fields
+static lval* values = NULL;
+static lenv* envs = NULL;
+
+static lenv** root_envs = NULL;
+static int nroot_envs = 0;
+// Long-lived roots, such as cached module exports
+static lval** fixed_vals = NULL;
+static int nfixed_vals = 0;
+// Roots pushed and popped in LIFO order by the evaluator
+static lval** root_vals = NULL;
+static int nroot_vals = 0;
+static int root_vals_cap = 0;
+
+// Nesting of S-expression evaluation; only depth 0 is a safepoint
+static int depth = 0;
+static unsigned long allocated = 0;
+static unsigned long threshold = LGC_MIN_THRESHOLD;
+
+static unsigned long collections = 0;
+static unsigned long freed_vals = 0;
+static unsigned long freed_envs = 0;
+
+void lgc_track_val(lval* v) {
+    v->gc_mark = 0;
+    v->gc_prev = NULL;
+    v->gc_next = values;
+    if (values) {
+        values->gc_prev = v;
+    }
+    values = v;
+    allocated++;
+}
+
+void lgc_untrack_val(lval* v) {
+    if (v->gc_prev) {
+        v->gc_prev->gc_next = v->gc_next;
+    }
+    else {
+        values = v->gc_next;
+    }
+    if (v->gc_next) {
+        v->gc_next->gc_prev = v->gc_prev;
+    }
+}
+
+void lgc_track_env(lenv* e) {
+    e->gc_mark = 0;
+    e->gc_prev = NULL;
+    e->gc_next = envs;
+    if (envs) {
+        envs->gc_prev = e;
+    }
+    envs = e;
+    allocated++;
+}
+
+void lgc_untrack_env(lenv* e) {
+    if (e->gc_prev) {
+        e->gc_prev->gc_next = e->gc_next;
+    }
+    else {
+        envs = e->gc_next;
+    }
+    if (e->gc_next) {
+        e->gc_next->gc_prev = e->gc_prev;
+    }
+}
+
+void lgc_add_root_env(lenv* e) {
+    nroot_envs++;
+    root_envs = realloc(root_envs, sizeof(lenv*) * nroot_envs);
+    root_envs[nroot_envs - 1] = e;
+}
+
+void lgc_remove_root_env(lenv* e) {
+    for (int i = 0; i < nroot_envs; i++) {
+        if (root_envs[i] == e) {
+            root_envs[i] = root_envs[--nroot_envs];
+            return;
+        }
+    }
+}
+
+void lgc_add_root_val(lval* v) {
+    nfixed_vals++;
+    fixed_vals = realloc(fixed_vals, sizeof(lval*) * nfixed_vals);
+    fixed_vals[nfixed_vals - 1] = v;
+}
+
+void lgc_remove_root_val(lval* v) {
+    for (int i = 0; i < nfixed_vals; i++) {
+        if (fixed_vals[i] == v) {
+            fixed_vals[i] = fixed_vals[--nfixed_vals];
+            return;
+        }
+    }
+}
+
+void lgc_push_root(lval* v) {
+    if (nroot_vals == root_vals_cap) {
+        root_vals_cap = root_vals_cap ? root_vals_cap * 2 : 16;
+        root_vals = realloc(root_vals, sizeof(lval*) * root_vals_cap);
+    }
+    root_vals[nroot_vals++] = v;
+}
+
+void lgc_pop_root(void) {
+    nroot_vals--;
+}
+
+void lgc_enter(void) { depth++; }
+void lgc_leave(void) { depth--; }
+
+/* Marking uses an explicit stack so deeply nested data can't overflow the
+ * C stack. Environments are pushed tagged with their low bit set.
+ */
+static void** mark_stack = NULL;
+static int mark_count = 0;
+static int mark_cap = 0;
+
+static void lgc_mark_push(void* p) {
+    if (mark_count == mark_cap) {
+        mark_cap = mark_cap ? mark_cap * 2 : 256;
+        mark_stack = realloc(mark_stack, sizeof(void*) * mark_cap);
+    }
+    mark_stack[mark_count++] = p;
+}
+
+static void lgc_mark_env(lenv* e) {
+    if (e && !e->gc_mark) {
+        e->gc_mark = 1;
+        lgc_mark_push((void*)((uintptr_t)e | 1));
+    }
+}
+
+static void lgc_mark_val(lval* v) {
+    if (v && !v->gc_mark) {
+        v->gc_mark = 1;
+        lgc_mark_push(v);
+    }
+}
+
+static void lgc_mark(void) {
+    for (int i = 0; i < nroot_envs; i++) {
+        lgc_mark_env(root_envs[i]);
+    }
+    for (int i = 0; i < nfixed_vals; i++) {
+        lgc_mark_val(fixed_vals[i]);
+    }
+    for (int i = 0; i < nroot_vals; i++) {
+        lgc_mark_val(root_vals[i]);
+    }
+
+    while (mark_count) {
+        uintptr_t p = (uintptr_t)mark_stack[--mark_count];
+        if (p & 1) {
+            lenv* e = (lenv*)(p & ~(uintptr_t)1);
+            for (int i = 0; i < e->count; i++) {
+                lgc_mark_val(e->vals[i]);
+            }
+            lgc_mark_env(e->proto);
+            continue;
+        }
+
+        lval* v = (lval*)p;
+        switch (v->type) {
+        case LVAL_SEXPR:
+        case LVAL_QEXPR:
+            // The buffer keeps everything in it alive, not just this view
+            if (v->buf) {
+                for (int i = v->buf->lo; i < v->buf->hi; i++) {
+                    lgc_mark_val(v->buf->items[i]);
+                }
+            }
+            break;
+        case LVAL_FUN:
+            if (v->builtin == NULL) {
+                lgc_mark_env(v->env);
+                lgc_mark_val(v->formals);
+                lgc_mark_val(v->body);
+                if (v->code) {
+                    lgc_mark_val(v->code->body);
+                }
+            }
+            break;
+        case LVAL_CONS:
+            lgc_mark_val(v->car);
+            lgc_mark_val(v->cdr);
+            break;
+        }
+    }
+}
+
+// A reachable child loses the reference an unreachable parent held on it
+static void lgc_release(lval* child) {
+    if (child->gc_mark && !lval_is_immortal(child)) {
+        child->refs--;
+    }
+}
+
+static void lgc_sweep(void) {
+    // First settle reference counts, while every node is still intact
+    for (lval* v = values; v; v = v->gc_next) {
+        if (v->gc_mark) {
+            continue;
+        }
+        if ((v->type == LVAL_SEXPR || v->type == LVAL_QEXPR) && v->buf &&
+            --v->buf->refs == 0) {
+            for (int i = v->buf->lo; i < v->buf->hi; i++) {
+                lgc_release(v->buf->items[i]);
+            }
+            free(v->buf);
+        }
+        if (v->type == LVAL_FUN && v->builtin == NULL) {
+            lgc_release(v->formals);
+            lgc_release(v->body);
+            lval* code = v->code ? lcode_release(v->code) : NULL;
+            if (code) {
+                lgc_release(code);
+            }
+            if (v->env->gc_mark) {
+                v->env->refs--;
+            }
+        }
+        if (v->type == LVAL_CONS && v->len) {
+            lgc_release(v->car);
+            lgc_release(v->cdr);
+        }
+    }
+    for (lenv* e = envs; e; e = e->gc_next) {
+        if (!e->gc_mark) {
+            for (int i = 0; i < e->count; i++) {
+                lgc_release(e->vals[i]);
+            }
+            if (e->proto && e->proto->gc_mark) {
+                e->proto->refs--;
+            }
+        }
+    }
+
+    // Then free the unreachable nodes without recursing into children
+    lval* v = values;
+    while (v) {
+        lval* next = v->gc_next;
+        if (v->gc_mark) {
+            v->gc_mark = 0;
+        }
+        else {
+            switch (v->type) {
+            case LVAL_ERR: free(v->err); break;
+            case LVAL_STR: free(v->str); break;
+            }
+            lgc_untrack_val(v);
+            lpool_free(v, sizeof(lval));
+            freed_vals++;
+        }
+        v = next;
+    }
+
+    lenv* e = envs;
+    while (e) {
+        lenv* next = e->gc_next;
+        if (e->gc_mark) {
+            e->gc_mark = 0;
+        }
+        else {
+            lenv_free_tables(e);
+            lgc_untrack_env(e);
+            lpool_free(e, sizeof(lenv));
+            freed_envs++;
+        }
+        e = next;
+    }
+}
+
+unsigned long lgc_live(void) {
+    unsigned long live = 0;
+    for (lval* v = values; v; v = v->gc_next) { live++; }
+    for (lenv* e = envs; e; e = e->gc_next) { live++; }
+    return live;
+}
+
+void lgc_collect(void) {
+    lgc_mark();
+    lgc_sweep();
+    collections++;
+
+    unsigned long live = lgc_live();
+    threshold = live > LGC_MIN_THRESHOLD ? live : LGC_MIN_THRESHOLD;
+    allocated = 0;
+}
+
+void lgc_safepoint(void) {
+    if (depth == 0 && allocated >= threshold) {
+        lgc_collect();
+    }
+}
+
+void lgc_print_stats(void) {
+    printf("gc: %lu collections, %lu values and %lu environments reclaimed\n",
+           collections, freed_vals, freed_envs);
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+#include "../config.h"
+
+typedef struct lval lval;
+typedef struct lenv lenv;
+
+/* Optional tracing collector, enabled with ./configure --enable-gc.
+ *
+ * Reference counting still frees most values the moment they die. The
+ * collector runs at top-level safepoints (between expressions in the REPL
+ * and in load) and reclaims whatever reference counting cannot: values and
+ * environments that were leaked or are only reachable from each other.
+ * Roots are the registered environments and values plus the values the
+ * evaluator has pushed with lgc_push_root.
+ */
+#ifdef LISPY_GC
+
+// Collect once this many nodes have been allocated since the last collection
+#define LGC_MIN_THRESHOLD 10000
+
+void lgc_track_val(lval* v);
+void lgc_untrack_val(lval* v);
+void lgc_track_env(lenv* e);
+void lgc_untrack_env(lenv* e);
+
+void lgc_add_root_env(lenv* e);
+void lgc_remove_root_env(lenv* e);
+void lgc_add_root_val(lval* v);
+void lgc_remove_root_val(lval* v);
+void lgc_push_root(lval* v);
+void lgc_pop_root(void);
+
+void lgc_enter(void);
+void lgc_leave(void);
+void lgc_safepoint(void);
+void lgc_collect(void);
+unsigned long lgc_live(void);
+void lgc_print_stats(void);
+
+#else
+
+#define lgc_track_val(v)
+#define lgc_untrack_val(v)
+#define lgc_track_env(e)
+#define lgc_untrack_env(e)
+#define lgc_add_root_env(e)
+#define lgc_remove_root_env(e)
+#define lgc_add_root_val(v)
+#define lgc_remove_root_val(v)
+#define lgc_push_root(v)
+#define lgc_pop_root()
+#define lgc_enter()
+#define lgc_leave()
+#define lgc_safepoint()
+#define lgc_collect()
+#define lgc_print_stats()
+
+#endif
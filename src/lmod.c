@@ -0,0 +1,155 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "lmod.h"
+#include "lenv.h"
+#include "lval.h"
+#include "lgc.h"
+
+static lmod* modules = NULL;
+
+static lmod* lmod_find(char* path) {
+    for (lmod* m = modules; m; m = m->next) {
+        if (strcmp(m->path, path) == 0) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+/* Evaluate the file at path in its own environment and collect what it
+ * defined, and into consts which of those are constants. That includes
+ * builtins it redefined: the builtins' values are held on to while it
+ * runs, so a slot whose value changed was bound by the module. The
+ * environment is dropped afterwards: only the exports need to outlive the
+ * load, and keeping a second copy of every builtin bound would stop global
+ * lookups from being cached (see lenv_get_cached).
+ */
+static lval* lmod_eval(char* path, unsigned char** consts) {
+    lenv* env = lenv_new();
+    lenv_add_builtins(env);
+    int base = env->count;
+    lgc_add_root_env(env);
+
+    lval* builtins = lval_qexpr();
+    lval_reserve(builtins, base);
+    for (int i = 0; i < base; i++) {
+        lval_add(builtins, lval_copy(env->vals[i]));
+    }
+    lgc_add_root_val(builtins);
+
+    lval* x = builtin_load(env, lval_add(lval_sexpr(), lval_str(path)));
+    if (x->type != LVAL_ERR) {
+        lval_delete(x);
+        x = lval_qexpr();
+        lval_reserve(x, 2 * (env->count - base));
+        *consts = calloc(env->count + 1, 1);
+        int n = 0;
+        for (int i = 0; i < env->count; i++) {
+            if (i < base && env->vals[i] == builtins->cell[i]) {
+                continue;
+            }
+            lval_add(x, lval_sym(env->syms[i]));
+            lval_add(x, lval_copy(env->vals[i]));
+            (*consts)[n++] = env->consts && env->consts[i];
+        }
+    }
+
+    lgc_remove_root_val(builtins);
+    lval_delete(builtins);
+    lgc_remove_root_env(env);
+    lenv_delete(env);
+    return x;
+}
+
+lval* builtin_import(lenv* e, lval* a) {
+    LASSERT_SIZE(a, 1, "Import only accepts one argument");
+    LASSERT_ARG_TYPE(a, 0, LVAL_STR,
+                     "First argument to import must be a %s not a %s",
+                     ltype_name(LVAL_STR), ltype_name(a->cell[0]->type));
+
+    char path[PATH_MAX];
+    struct stat st;
+    if (realpath(a->cell[0]->str, path) == NULL || stat(path, &st) != 0) {
+        lval* err = lval_err("Could not import %s", a->cell[0]->str);
+        lval_delete(a);
+        return err;
+    }
+    lval_delete(a);
+
+    lmod* m = lmod_find(path);
+    if (m && m->exports == NULL) {
+        return lval_err("Circular import of %s", path);
+    }
+    if (m == NULL || m->mtime != st.st_mtime) {
+        if (m == NULL) {
+            m = malloc(sizeof(lmod));
+            m->path = strdup(path);
+            m->next = modules;
+            modules = m;
+        }
+        else {
+            lgc_remove_root_val(m->exports);
+            lval_delete(m->exports);
+            free(m->consts);
+        }
+        m->mtime = st.st_mtime;
+        m->exports = NULL;
+        m->consts = NULL;
+
+        lval* x = lmod_eval(path, &m->consts);
+        if (x->type == LVAL_ERR) {
+            // Forget the module so the next import tries again. Modules it
+            // imported may have been added in front of it.
+            lmod** p = &modules;
+            while (*p != m) {
+                p = &(*p)->next;
+            }
+            *p = m->next;
+            free(m->path);
+            free(m);
+            return x;
+        }
+        m->exports = x;
+        lgc_add_root_val(x);
+    }
+
+    // Exports go in the root environment, as def would bind them, so an
+    // import inside a function outlives the call. Check them all first so
+    // that a clash binds none of them.
+    for (int i = 0; i < m->exports->count; i += 2) {
+        char* sym = m->exports->cell[i]->sym;
+        if (lenv_is_const(e, sym) == LENV_CONST) {
+            return lval_err("Cannot redefine constant %s", sym);
+        }
+    }
+    for (int i = 0; i < m->exports->count; i += 2) {
+        lenv_def_import(e, m->exports->cell[i], m->exports->cell[i + 1],
+                        m->consts[i / 2]);
+    }
+    return lval_sexpr();
+}
+
+int lmod_count(void) {
+    int n = 0;
+    for (lmod* m = modules; m; m = m->next) {
+        n++;
+    }
+    return n;
+}
+
+void lmod_destroy(void) {
+    while (modules) {
+        lmod* next = modules->next;
+        if (modules->exports) {
+            lgc_remove_root_val(modules->exports);
+            lval_delete(modules->exports);
+        }
+        free(modules->consts);
+        free(modules->path);
+        free(modules);
+        modules = next;
+    }
+}
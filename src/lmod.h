@@ -0,0 +1,32 @@
+#pragma once
+#include <time.h>
+
+typedef struct lval lval;
+typedef struct lenv lenv;
+
+/* Modules loaded with import. Each file is evaluated once, in a fresh
+ * environment holding only the builtins, and whatever it defines or
+ * redefines there becomes its exports. The cache is keyed on the file's
+ * canonical path and re-evaluates it only when its modification time
+ * changes.
+ *
+ * Importing binds the exports in the root of the importing environment,
+ * like def. It fails if any of them is a constant the importer defined
+ * itself; constants bound by an earlier import are replaced, so a reloaded
+ * module's constants take their new values.
+ */
+typedef struct lmod lmod;
+struct lmod {
+    lmod* next;
+    char* path;
+    time_t mtime;
+    // Q-Expression of alternating names and values, or NULL while the
+    // module is still being evaluated
+    lval* exports;
+    // One flag per export, set for those bound with defconst
+    unsigned char* consts;
+};
+
+lval* builtin_import(lenv* e, lval* a);
+int lmod_count(void);
+void lmod_destroy(void);
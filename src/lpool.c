@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lpool.h"
+
+// The interpreter's pool. Every lval and lenv node comes from here.
+static lpool pool;
+
+static int lpool_class_of(size_t size) {
+    return (int)((size + LPOOL_GRANULE - 1) / LPOOL_GRANULE) - 1;
+}
+
+static void lpool_grow(lpool_class* c, size_t size) {
+    lpool_slab* slab = malloc(LPOOL_SLAB_BYTES);
+    slab->next = c->slabs;
+    c->slabs = slab;
+    c->nslabs++;
+
+    // Carve the slab (after its header) into blocks threaded onto the
+    // free list.
+    char* start = (char*)slab + LPOOL_GRANULE;
+    size_t n = (LPOOL_SLAB_BYTES - LPOOL_GRANULE) / size;
+    for (size_t i = 0; i < n; i++) {
+        void** block = (void**)(start + i * size);
+        *block = c->free_list;
+        c->free_list = block;
+    }
+}
+
+void* lpool_alloc(size_t size) {
+    int i = lpool_class_of(size);
+    if (i >= LPOOL_CLASSES) {
+        pool.large_allocs++;
+        return malloc(size);
+    }
+
+    lpool_class* c = &pool.classes[i];
+    c->allocs++;
+    if (c->free_list) {
+        c->hits++;
+    }
+    else {
+        lpool_grow(c, (size_t)(i + 1) * LPOOL_GRANULE);
+    }
+
+    void** block = c->free_list;
+    c->free_list = *block;
+    return block;
+}
+
+void lpool_free(void* p, size_t size) {
+    int i = lpool_class_of(size);
+    if (i >= LPOOL_CLASSES) {
+        pool.large_frees++;
+        free(p);
+        return;
+    }
+
+    lpool_class* c = &pool.classes[i];
+    c->frees++;
+    *(void**)p = c->free_list;
+    c->free_list = p;
+}
+
+void lpool_destroy(void) {
+    for (int i = 0; i < LPOOL_CLASSES; i++) {
+        lpool_slab* slab = pool.classes[i].slabs;
+        while (slab) {
+            lpool_slab* next = slab->next;
+            free(slab);
+            slab = next;
+        }
+    }
+    pool = (lpool){0};
+}
+
+lpool* lpool_get(void) {
+    return &pool;
+}
+
+void lpool_print_stats(void) {
+    printf("%-6s %10s %10s %10s %6s %7s\n",
+           "class", "allocs", "frees", "hits", "slabs", "hit%");
+    for (int i = 0; i < LPOOL_CLASSES; i++) {
+        lpool_class* c = &pool.classes[i];
+        if (c->allocs == 0) {
+            continue;
+        }
+        printf("%-6d %10lu %10lu %10lu %6lu %6.1f%%\n",
+               (i + 1) * LPOOL_GRANULE, c->allocs, c->frees, c->hits,
+               c->nslabs, 100.0 * c->hits / c->allocs);
+    }
+    printf("%-6s %10lu %10lu\n", "large", pool.large_allocs, pool.large_frees);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+
+// Allocations are rounded up to a multiple of the granule and served from
+// the free list of that size class. Anything larger than the biggest class
+// goes straight to malloc.
+#define LPOOL_GRANULE 16
+#define LPOOL_CLASSES 8
+#define LPOOL_SLAB_BYTES 16384
+
+typedef struct lpool_slab lpool_slab;
+struct lpool_slab {
+    lpool_slab* next;
+};
+
+typedef struct lpool_class {
+    void* free_list;
+    lpool_slab* slabs;
+
+    unsigned long allocs;
+    unsigned long frees;
+    // Allocations served from the free list instead of a fresh slab
+    unsigned long hits;
+    unsigned long nslabs;
+} lpool_class;
+
+typedef struct lpool {
+    lpool_class classes[LPOOL_CLASSES];
+    unsigned long large_allocs;
+    unsigned long large_frees;
+} lpool;
+
+void* lpool_alloc(size_t size);
+void lpool_free(void* p, size_t size);
+void lpool_destroy(void);
+lpool* lpool_get(void);
+void lpool_print_stats(void);
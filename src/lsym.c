@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lsym.h"
+
+// Open addressed, linear probing, power of two capacity
+static lsym** table = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+
+static unsigned long lsym_hash(const char* s) {
+    // FNV-1a
+    unsigned long h = 2166136261UL;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+static void lsym_insert(lsym* sym) {
+    size_t i = sym->hash & (capacity - 1);
+    while (table[i]) {
+        i = (i + 1) & (capacity - 1);
+    }
+    table[i] = sym;
+}
+
+static void lsym_grow(void) {
+    lsym** old = table;
+    size_t old_capacity = capacity;
+
+    capacity = capacity ? capacity * 2 : LSYM_INITIAL_CAPACITY;
+    table = calloc(capacity, sizeof(lsym*));
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i]) {
+            lsym_insert(old[i]);
+        }
+    }
+    free(old);
+}
+
+char* lsym_intern(const char* name) {
+    // Keep the load factor under 2/3
+    if ((count + 1) * 3 > capacity * 2) {
+        lsym_grow();
+    }
+
+    unsigned long h = lsym_hash(name);
+    size_t i = h & (capacity - 1);
+    while (table[i]) {
+        if (table[i]->hash == h && strcmp(table[i]->name, name) == 0) {
+            return table[i]->name;
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+
+    lsym* sym = malloc(sizeof(lsym) + strlen(name) + 1);
+    sym->hash = h;
+    sym->binds = 0;
+    strcpy(sym->name, name);
+    table[i] = sym;
+    count++;
+    return sym->name;
+}
+
+lsym* lsym_of(char* interned) {
+    return (lsym*)(interned - offsetof(lsym, name));
+}
+
+size_t lsym_count(void) {
+    return count;
+}
+
+void lsym_destroy(void) {
+    for (size_t i = 0; i < capacity; i++) {
+        free(table[i]);
+    }
+    free(table);
+    table = NULL;
+    capacity = 0;
+    count = 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stddef.h>
+
+/* Every symbol name is stored exactly once in a global intern table. Two
+ * symbols are the same symbol iff their name pointers are equal, so
+ * environments and lval_eq compare pointers instead of calling strcmp.
+ */
+typedef struct lsym {
+    unsigned long hash;
+    // Number of live environment bindings of this name, see lenv_get_cached
+    int binds;
+    char name[];
+} lsym;
+
+#define LSYM_INITIAL_CAPACITY 256
+
+char* lsym_intern(const char* name);
+lsym* lsym_of(char* interned);
+size_t lsym_count(void);
+void lsym_destroy(void);
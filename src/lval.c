@@ -2,6 +2,11 @@
 #include <stdlib.h>
 
 #include "lval.h"
+#include "lcode.h"
+#include "lframe.h"
+#include "lgc.h"
+#include "lpool.h"
+#include "lsym.h"
 #include "mpc.h"
 
 char* ltype_name(int t) {
@@ -12,21 +17,53 @@ char* ltype_name(int t) {
     case LVAL_SYM: return "Symbol";
     case LVAL_SEXPR: return "S-Expression";
     case LVAL_QEXPR: return "Q-Expression";
+    case LVAL_CONS: return "Cons-List";
     case LVAL_STR: return "String";
     default: return "Unknown";
     }
 }
 
+static lval* lval_new(int type) {
+    lval* v = lpool_alloc(sizeof(lval));
+    v->type = type;
+    v->refs = 1;
+    lgc_track_val(v);
+    return v;
+}
+
+/* Small integers are preallocated once and shared. They are never freed and
+ * never mutated, so lval_num, lval_copy and lval_delete on them cost nothing.
+ */
+static lval lval_small_nums[LVAL_SMALL_NUM_MAX - LVAL_SMALL_NUM_MIN + 1];
+static int lval_small_nums_ready = 0;
+
+// The empty Cons-List, shared like the small numbers
+static lval lval_nil_cell = { .type = LVAL_CONS };
+
+int lval_is_immortal(lval* v) {
+    return (v >= lval_small_nums &&
+            v < lval_small_nums + (LVAL_SMALL_NUM_MAX - LVAL_SMALL_NUM_MIN + 1))
+        || v == &lval_nil_cell;
+}
+
 lval* lval_num (long x) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_NUM;
+    if (x >= LVAL_SMALL_NUM_MIN && x <= LVAL_SMALL_NUM_MAX) {
+        if (!lval_small_nums_ready) {
+            for (long n = LVAL_SMALL_NUM_MIN; n <= LVAL_SMALL_NUM_MAX; n++) {
+                lval_small_nums[n - LVAL_SMALL_NUM_MIN].type = LVAL_NUM;
+                lval_small_nums[n - LVAL_SMALL_NUM_MIN].num = n;
+            }
+            lval_small_nums_ready = 1;
+        }
+        return &lval_small_nums[x - LVAL_SMALL_NUM_MIN];
+    }
+    lval* v = lval_new(LVAL_NUM);
     v->num = x;
     return v;
 }
 
 lval* lval_err(char* fmt, ...) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_ERR;
+    lval* v = lval_new(LVAL_ERR);
 
     va_list va;
     va_start(va, fmt);
@@ -39,96 +76,384 @@ lval* lval_err(char* fmt, ...) {
 }
 
 lval* lval_sym(char* s) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_SYM;
-    v->sym = malloc(strlen(s) + 1);
-    strcpy(v->sym, s);
+    lval* v = lval_new(LVAL_SYM);
+    v->sym = lsym_intern(s);
+    v->slot = -1;
+    v->ic_version = 0;
 
     return v;
 }
 
 lval* lval_sexpr(void) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_SEXPR;
+    lval* v = lval_new(LVAL_SEXPR);
     v->count = 0;
     v->cell = NULL;
+    v->buf = NULL;
 
     return v;
 }
 
 lval* lval_qexpr(void) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_QEXPR;
+    lval* v = lval_new(LVAL_QEXPR);
     v->count = 0;
     v->cell = NULL;
+    v->buf = NULL;
 
     return v;
 }
 
 lval* lval_fun(lbuiltin func) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_FUN;
+    lval* v = lval_new(LVAL_FUN);
     v->builtin = func;
+    v->special = 0;
+    v->fixed = NULL;
+    v->arity = -1;
     return v;
 }
 
 lval* lval_str(char* s) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_STR;
+    lval* v = lval_new(LVAL_STR);
     v->str = malloc(strlen(s) + 1);
     strcpy(v->str, s);
     return v;
 }
 
-void lval_delete(lval* v) {
+lval* lval_nil(void) {
+    return &lval_nil_cell;
+}
+
+lval* lval_cons(lval* car, lval* cdr) {
+    lval* v = lval_new(LVAL_CONS);
+    v->car = car;
+    v->cdr = cdr;
+    v->len = cdr->len + 1;
+    return v;
+}
+
+/* Values whose last reference is gone but whose children are still to be
+ * released. Deleting pushes children here and drains it in a loop rather
+ * than recursing, so deeply nested lists can't overflow the C stack.
+ * Deletes nest (an environment freed on the way deletes its values), each
+ * draining only what it pushed.
+ */
+static lval** doomed = NULL;
+static int doomed_count = 0;
+static int doomed_cap = 0;
+
+static void lval_doom(lval* v) {
+    if (v == NULL || lval_is_immortal(v) || --v->refs > 0) {
+        return;
+    }
+    if (doomed_count == doomed_cap) {
+        doomed_cap = doomed_cap ? doomed_cap * 2 : 64;
+        doomed = realloc(doomed, sizeof(lval*) * doomed_cap);
+    }
+    doomed[doomed_count++] = v;
+}
+
+static void lcells_doom(lcells* b) {
+    if (b == NULL || --b->refs > 0) {
+        return;
+    }
+    for (int i = b->lo; i < b->hi; i++) {
+        lval_doom(b->items[i]);
+    }
+    free(b);
+}
+
+// Free v, whose last reference is gone, dooming its children
+static void lval_free(lval* v) {
     switch(v->type) {
     case LVAL_NUM:
         break;
     case LVAL_ERR:
         free(v->err);
         break;
-    case LVAL_SYM:
-        free(v->sym);
-        break;
     case LVAL_STR:
         free(v->str);
         break;
     case LVAL_QEXPR:
     case LVAL_SEXPR:
-        for (int i = 0; i < v->count; i++) {
-            lval_delete(v->cell[i]);
-        }
-        free(v->cell);
+        lcells_doom(v->buf);
         break;
     case LVAL_FUN:
         if (v->builtin == NULL) {
             lenv_delete(v->env);
-            lval_delete(v->formals);
-            lval_delete(v->body);
+            lval_doom(v->formals);
+            lval_doom(v->body);
+            if (v->code) {
+                lval_doom(lcode_release(v->code));
+            }
         }
         break;
+    case LVAL_CONS:
+        lval_doom(v->car);
+        lval_doom(v->cdr);
+        break;
+    }
+    lgc_untrack_val(v);
+    lpool_free(v, sizeof(lval));
+}
+
+static void lval_free_doomed(int base) {
+    while (doomed_count > base) {
+        lval_free(doomed[--doomed_count]);
+    }
+}
+
+void lval_delete(lval* v) {
+    if (v == NULL || lval_is_immortal(v) || --v->refs > 0) {
+        return;
+    }
+    int base = doomed_count;
+    lval_free(v);
+    lval_free_doomed(base);
+}
+
+static lcells* lcells_new(int cap) {
+    lcells* b = malloc(sizeof(lcells) + sizeof(lval*) * cap);
+    b->refs = 1;
+    b->cap = cap;
+    b->lo = 0;
+    b->hi = 0;
+    return b;
+}
+
+void lcells_release(lcells* b) {
+    int base = doomed_count;
+    lcells_doom(b);
+    lval_free_doomed(base);
+}
+
+/* Make v the sole owner of a buffer holding exactly its cells, with room
+ * for at least n cells from cell[0] on. Only the view of a shared buffer
+ * is copied, never the buffer as a whole.
+ */
+static void lval_own_cells(lval* v, int n) {
+    if (n < v->count) {
+        n = v->count;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    lcells* b = v->buf;
+    if (b && b->refs == 1) {
+        // Values outside the view belonged to lists that are gone now
+        int start = v->cell - b->items;
+        for (int i = b->lo; i < start; i++) {
+            lval_delete(b->items[i]);
+        }
+        for (int i = start + v->count; i < b->hi; i++) {
+            lval_delete(b->items[i]);
+        }
+        b->lo = start;
+        b->hi = start + v->count;
+        if (start + n <= b->cap) {
+            return;
+        }
+
+        memmove(b->items, v->cell, sizeof(lval*) * v->count);
+        b->lo = 0;
+        b->hi = v->count;
+        if (n > b->cap) {
+            b = realloc(b, sizeof(lcells) + sizeof(lval*) * n);
+            b->cap = n;
+        }
+        v->buf = b;
+        v->cell = b->items;
+        return;
+    }
+
+    lcells* x = lcells_new(n);
+    for (int i = 0; i < v->count; i++) {
+        x->items[i] = lval_copy(v->cell[i]);
     }
-    free(v);
+    x->hi = v->count;
+    lcells_release(b);
+    v->buf = x;
+    v->cell = x->items;
+}
+
+lval* lval_reserve(lval* v, int n) {
+    lval_own_cells(v, n);
+    return v;
 }
 
 lval* lval_add(lval* v, lval* x) {
+    lcells* b = v->buf;
+    if (b == NULL || b->refs > 1 || b->hi == b->cap ||
+        v->cell + v->count != b->items + b->hi) {
+        // Double, so N appends cost O(N)
+        lval_own_cells(v, v->count < LVAL_MIN_CAP ?
+                       LVAL_MIN_CAP : v->count * 2);
+        b = v->buf;
+    }
+    b->items[b->hi++] = x;
     v->count++;
-    v->cell = realloc(v->cell, sizeof(lval*) * v->count);
-    v->cell[v->count - 1] = x;
     return v;
 }
 
-lval* lval_lambda(lval* formals, lval* body) {
-    lval* v = malloc(sizeof(lval));
-    v->type = LVAL_FUN;
+/* Record on each symbol in body naming one of formals the frame slot
+ * lval_call binds that formal to. Only the lambda's own frame can be
+ * addressed this way: with dynamic scoping the frames above it depend on
+ * the caller. The slot is a hint, checked again by lval_eval, since the
+ * nodes may be shared with other bodies and a nested lambda's body runs in
+ * a differently laid out frame. Returns 0, part way through, if body nests
+ * deeper than LVAL_MAX_DEPTH: this and compiling recurse on the C stack.
+ */
+static int lval_resolve(lval* body, lval* formals, int depth) {
+    if (depth > LVAL_MAX_DEPTH) {
+        return 0;
+    }
+    switch (body->type) {
+    case LVAL_SYM: {
+        int slot = 0;
+        for (int i = 0; i < formals->count; i++) {
+            lval* f = formals->cell[i];
+            if (f->type != LVAL_SYM || f->sym == lsym_intern("&")) {
+                continue;
+            }
+            if (f->sym == body->sym) {
+                body->slot = slot;
+                return 1;
+            }
+            slot++;
+        }
+        break;
+    }
+    case LVAL_SEXPR:
+    case LVAL_QEXPR:
+        for (int i = 0; i < body->count; i++) {
+            if (!lval_resolve(body->cell[i], formals, depth + 1)) {
+                return 0;
+            }
+        }
+        break;
+    }
+    return 1;
+}
+
+/* Precompute how lval_call binds f's formals. Formals that aren't all
+ * distinct symbols (including those already bound by partial
+ * application), or whose '&' isn't followed by exactly one symbol, are
+ * left with arity -1 for the general path to bind and report on.
+ */
+static void lval_fun_shape(lval* f) {
+    lval* formals = f->formals;
+    char* amp = lsym_intern("&");
+    int n = formals->count;
+    int arity = n;
+
+    f->arity = -1;
+    f->variadic = 0;
+    for (int i = 0; i < n; i++) {
+        lval* s = formals->cell[i];
+        if (s->type != LVAL_SYM) {
+            return;
+        }
+        if (s->sym == amp) {
+            if (i != n - 2) {
+                return;
+            }
+            arity = i;
+        }
+        for (int j = 0; j < i; j++) {
+            if (formals->cell[j]->sym == s->sym) {
+                return;
+            }
+        }
+        for (int j = 0; j < f->env->count; j++) {
+            if (f->env->syms[j] == s->sym) {
+                return;
+            }
+        }
+    }
+    f->arity = arity;
+    f->variadic = arity < n;
+}
+
+static lval* lval_inline_consts(lenv* e, lval* v);
+
+/* A lambda whose code is compiled with the constants bound in e inlined,
+ * or from body as written when e is NULL. The inlined copy belongs to the
+ * code; the lambda keeps body as written, so it prints as it was given.
+ * An error if body nests too deeply (see lval_resolve).
+ */
+static lval* lval_lambda_in(lenv* e, lval* formals, lval* body) {
+    if (!lval_resolve(body, formals, 0)) {
+        lval_delete(formals);
+        lval_delete(body);
+        return lval_err("Lambda body nested more than %d deep",
+                        LVAL_MAX_DEPTH);
+    }
+    lval* v = lval_new(LVAL_FUN);
 
     v->builtin = NULL;
+    v->special = 0;
     v->env = lenv_new();
     v->formals = formals;
     v->body = body;
+    lval* code = lval_copy(body);
+    if (e) {
+        code = lval_inline_consts(e, code);
+    }
+    v->code = lcode_compile(code);
+    lval_fun_shape(v);
     return v;
 }
 
+lval* lval_lambda(lval* formals, lval* body) {
+    return lval_lambda_in(NULL, formals, body);
+}
+
+mpc_parser_t* Number;
+mpc_parser_t* Symbol;
+mpc_parser_t* Sexpr;
+mpc_parser_t* Qexpr;
+mpc_parser_t* Expr;
+mpc_parser_t* Lispy;
+mpc_parser_t* String;
+mpc_parser_t* Comment;
+
+/* Build the reader's grammar into the parsers declared in lval.h. Calling
+ * it again once built does nothing.
+ */
+void lval_grammar_init(void) {
+    if (Lispy) {
+        return;
+    }
+    Number = mpc_new("number");
+    Symbol = mpc_new("symbol");
+    Sexpr  = mpc_new("sexpr");
+    Qexpr  = mpc_new("qexpr");
+    Expr   = mpc_new("expr");
+    Lispy  = mpc_new("lispy");
+    String = mpc_new("string");
+    Comment = mpc_new("comment");
+
+    mpca_lang(MPC_LANG_DEFAULT,
+  "                                                   \
+    number : /-?[0-9]+/ ;                             \
+    symbol : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/ ;       \
+    sexpr  : '(' <expr>* ')' ;                        \
+    qexpr  : '{' <expr>* '}' ;                        \
+    expr   : <number> | <symbol> | <sexpr> | <qexpr> | <string> | <comment>;\
+    string : /\"(\\\\.|[^\"])*\"/ ;                  \
+    comment: /;[^\\r\\n]*/ ;                         \
+    lispy  : /^/ <expr>* /$/ ;               \
+  ",
+              Number, Symbol, Sexpr, Expr, Qexpr, Lispy, String, Comment);
+}
+
+void lval_grammar_cleanup(void) {
+    if (!Lispy) {
+        return;
+    }
+    mpc_cleanup(8, Number, Symbol, Sexpr, Qexpr, Expr, Lispy, String, Comment);
+    Lispy = NULL;
+}
+
 lval* lval_read_num(mpc_ast_t* t) {
     long x = strtol(t->contents, NULL, 10);
     return errno != ERANGE ? lval_num(x) :
@@ -165,6 +490,8 @@ lval* lval_read(mpc_ast_t* t) {
     if (strstr(t->tag, "qexpr")) {
         x = lval_qexpr();
     }
+    // Brackets and comments are skipped below, so this is an upper bound
+    lval_reserve(x, t->children_num);
     for (int i = 0; i < t->children_num; i++) {
         char* contents = t->children[i]->contents;
         char* tag = t->children[i]->tag;
@@ -180,18 +507,6 @@ lval* lval_read(mpc_ast_t* t) {
     return x;
 }
 
-void lval_expr_print(lenv* e, lval* v, char open, char close) {
-    putchar(open);
-    for (int i = 0; i < v->count; i++) {
-        lval_print(e, v->cell[i]);
-
-        if (i != (v->count - 1)) {
-            putchar(' ');
-        }
-    }
-    putchar(close);
-}
-
 void lval_print_str(lval* v) {
     char* escaped = malloc(strlen(v->str) + 1);
     strcpy(escaped, v->str);
@@ -200,38 +515,123 @@ void lval_print_str(lval* v) {
     free(escaped);
 }
 
-void lval_print(lenv* e, lval *v) {
+/* Printing works through an explicit stack of what is left to print
+ * rather than recursing, so deeply nested lists can be printed. A task is
+ * a value to print whole (next -1), a list or Cons-List to carry on with
+ * from element next, or just the character close when v is NULL.
+ */
+typedef struct lprint_task {
+    lval* v;
+    int next;
+    char close;
+} lprint_task;
+
+static lprint_task* print_tasks = NULL;
+static int print_count = 0;
+static int print_cap = 0;
+
+static void lval_print_push(lval* v, int next, char close) {
+    if (print_count == print_cap) {
+        print_cap = print_cap ? print_cap * 2 : 64;
+        print_tasks = realloc(print_tasks, sizeof(lprint_task) * print_cap);
+    }
+    print_tasks[print_count++] = (lprint_task){ v, next, close };
+}
+
+// Print v, leaving any elements it has on the task stack
+static void lval_print_node(lenv* e, lval* v) {
     switch (v->type) {
     case LVAL_NUM:   printf("%li", v->num); break;
     case LVAL_ERR:   printf("Error: %s", v->err); break;
     case LVAL_SYM:   printf("%s", v->sym); break;
     case LVAL_SEXPR:
         if (v->count) {
-            lval_expr_print(e, v, '(', ')');
+            putchar('(');
+            lval_print_push(v, 0, ')');
         }
         else {
             printf("ok");
         }
         break;
-    case LVAL_QEXPR: lval_expr_print(e, v, '{', '}'); break;
+    case LVAL_QEXPR:
+        putchar('{');
+        lval_print_push(v, 0, '}');
+        break;
+    case LVAL_CONS:
+        // Cons-lists print like Q-Expressions
+        putchar('{');
+        lval_print_push(v, 0, '}');
+        break;
     case LVAL_STR: lval_print_str(v); break;
-    case LVAL_FUN:
-        printf("<function:");
-        lval_print(e, lenv_lookup_sym(e, v));
+    case LVAL_FUN: {
+        char* name = v->builtin ? lenv_builtin_name(v->builtin) : v->env->name;
+        printf("<function:%s", name ? name : "");
+        lval_print_push(NULL, 0, '>');
         if (v->builtin == NULL) {
             printf("(\\ ");
-            lval_print(e, v->formals); putchar(' ');
-            lval_print(e, v->body); putchar(')');
+            lval_print_push(NULL, 0, ')');
+            lval_print_push(v->body, -1, 0);
+            lval_print_push(NULL, 0, ' ');
+            lval_print_push(v->formals, -1, 0);
         }
-        putchar('>');
         break;
     }
+    }
+}
+
+void lval_print(lenv* e, lval *v) {
+    int base = print_count;
+    lval_print_push(v, -1, 0);
+    while (print_count > base) {
+        lprint_task t = print_tasks[--print_count];
+        if (t.v == NULL) {
+            putchar(t.close);
+        }
+        else if (t.next < 0) {
+            lval_print_node(e, t.v);
+        }
+        else if (t.v->type == LVAL_CONS) {
+            // Walk the spine a cell at a time
+            if (t.v->len == 0) {
+                putchar(t.close);
+                continue;
+            }
+            if (t.next) {
+                putchar(' ');
+            }
+            lval_print_push(t.v->cdr, 1, t.close);
+            lval_print_push(t.v->car, -1, 0);
+        }
+        else {
+            if (t.next == t.v->count) {
+                putchar(t.close);
+                continue;
+            }
+            if (t.next) {
+                putchar(' ');
+            }
+            lval_print_push(t.v, t.next + 1, t.close);
+            lval_print_push(t.v->cell[t.next], -1, 0);
+        }
+    }
 }
 void lval_println (lenv* e, lval* v) { lval_print(e, v); putchar('\n'); }
 
 lval* lval_copy(lval* v) {
-    lval* x = malloc(sizeof(lval));
-    x->type = v->type;
+    if (!lval_is_immortal(v)) {
+        v->refs++;
+    }
+    return v;
+}
+
+/* A fresh node with the same contents as v. Children are shared, not
+ * copied: they are only ever mutated after their own lval_unshare.
+ */
+static lval* lval_dup(lval* v) {
+    if (lval_is_immortal(v)) {
+        return v;
+    }
+    lval* x = lval_new(v->type);
 
     switch (v->type) {
     case LVAL_NUM:
@@ -239,10 +639,23 @@ lval* lval_copy(lval* v) {
         break;
     case LVAL_FUN:
         x->builtin = v->builtin;
+        x->special = v->special;
         if (v->builtin == NULL) {
-            x->env = lenv_copy(v->env);
+            // Shared until argument binding writes to it (see lval_call)
+            x->env = v->env;
+            x->env->refs++;
             x->formals = lval_copy(v->formals);
             x->body = lval_copy(v->body);
+            x->code = v->code;
+            if (x->code) {
+                x->code->refs++;
+            }
+            x->arity = v->arity;
+            x->variadic = v->variadic;
+        }
+        else {
+            x->fixed = v->fixed;
+            x->arity = v->arity;
         }
         break;
 
@@ -251,8 +664,11 @@ lval* lval_copy(lval* v) {
         strcpy(x->err, v->err);
         break;
     case LVAL_SYM:
-        x->sym = malloc(strlen(v->sym) + 1);
-        strcpy(x->sym, v->sym);
+        x->sym = v->sym;
+        x->slot = v->slot;
+        x->ic_slot = v->ic_slot;
+        x->ic_env = v->ic_env;
+        x->ic_version = v->ic_version;
         break;
     case LVAL_STR:
         x->str = malloc(strlen(v->str) + 1);
@@ -261,24 +677,78 @@ lval* lval_copy(lval* v) {
 
     case LVAL_SEXPR:
     case LVAL_QEXPR:
+        // Share the cells; whichever list writes first copies its view
         x->count = v->count;
-        x->cell = malloc(sizeof(lval*) * x->count);
-        for (int i = 0; i < x->count; i++) {
-            x->cell[i] = lval_copy(v->cell[i]);
+        x->cell = v->cell;
+        x->buf = v->buf;
+        if (x->buf) {
+            x->buf->refs++;
         }
         break;
+    case LVAL_CONS:
+        x->car = lval_copy(v->car);
+        x->cdr = lval_copy(v->cdr);
+        x->len = v->len;
+        break;
     }
     return x;
 }
 
-lval* lval_eval_sexpr(lenv* e, lval* v) {
-    for (int i = 0; i < v->count; i++) {
-        v->cell[i] = lval_eval(e, v->cell[i]);
-        if (v->cell[i]->type == LVAL_ERR) {
-            return lval_take(v, i);
-        }
+lval* lval_unshare(lval* v) {
+    if (lval_is_immortal(v) || v->refs == 1) {
+        return v;
     }
+    lval* x = lval_dup(v);
+    lval_delete(v);
+    return x;
+}
+
+/* How deep evaluation is: S-expressions part way through evaluation plus
+ * calls in progress. Calls recurse on the C stack, so past max_depth
+ * evaluation stops with an error rather than overflowing it.
+ */
+static int depth = 0;
+static int max_depth = LVAL_MAX_DEPTH;
+
+int lval_set_max_depth(int n) {
+    int old = max_depth;
+    max_depth = n;
+    return old;
+}
+
+static lval* lval_depth_err(void) {
+    return lval_err("Maximum evaluation depth of %d exceeded", max_depth);
+}
 
+/* S-expressions part way through evaluation, each with the index of the
+ * cell being evaluated. Nested S-expressions are evaluated by pushing a
+ * frame here rather than by recursing, so deeply nested input can't
+ * overflow the C stack. Evaluations nest through calls, each using the
+ * frames above where it started.
+ */
+typedef struct leval_frame {
+    lval* v;
+    int i;
+} leval_frame;
+
+static leval_frame* eval_frames = NULL;
+static int eval_count = 0;
+static int eval_cap = 0;
+
+static void lval_eval_push(lval* v) {
+    if (eval_count == eval_cap) {
+        eval_cap = eval_cap ? eval_cap * 2 : 64;
+        eval_frames = realloc(eval_frames, sizeof(leval_frame) * eval_cap);
+    }
+    // Results are written back into the cells
+    v = lval_unshare(v);
+    lval_own_cells(v, 0);
+    eval_frames[eval_count++] = (leval_frame){ v, 0 };
+    depth++;
+}
+
+/* Apply an S-expression whose cells have all been evaluated. */
+static lval* lval_apply_sexpr(lenv* e, lval* v) {
     if (v->count == 0) {
         return v;
     }
@@ -286,13 +756,24 @@ lval* lval_eval_sexpr(lenv* e, lval* v) {
         return lval_take(v, 0);
     }
 
-    lval* f = lval_pop(v, 0);
+    // A builtin's fast path takes the arguments where they are
+    lval* f = v->cell[0];
+    if (f->type == LVAL_FUN && f->builtin && f->arity == v->count - 1) {
+        lval* x = f->fixed(e, v->cell + 1);
+        if (x) {
+            lval_delete(v);
+            return x;
+        }
+    }
+
+    f = lval_pop(v, 0);
     if (f->type != LVAL_FUN) {
         lval_delete(v);
-        if (f->count) {
-            return lval_err("S-expression should start with a %s not a %s",
-                            ltype_name(LVAL_FUN), ltype_name(f->type));
+        if (f->type != LVAL_SEXPR || f->count) {
+            lval* err = lval_err("S-expression should start with a %s not a %s",
+                                 ltype_name(LVAL_FUN), ltype_name(f->type));
             lval_delete(f);
+            return err;
         }
         lval* result = lval_str("ok");
         lval_delete(f);
@@ -303,22 +784,193 @@ lval* lval_eval_sexpr(lenv* e, lval* v) {
     return result;
 }
 
+static lval* lval_eval_sexpr(lenv* e, lval* v) {
+    if (depth >= max_depth) {
+        lval_delete(v);
+        return lval_depth_err();
+    }
+
+    int base = eval_count;
+    lval* x;
+    lval_eval_push(v);
+    for (;;) {
+        leval_frame* t = &eval_frames[eval_count - 1];
+        if (t->i < t->v->count) {
+            // Take the cell out, leaving an immortal in its place
+            lval* c = t->v->cell[t->i];
+            t->v->cell[t->i] = lval_nil();
+            if (c->type == LVAL_SEXPR) {
+                if (depth >= max_depth) {
+                    lval_delete(c);
+                    x = lval_depth_err();
+                    break;
+                }
+                lval_eval_push(c);
+                continue;
+            }
+            x = lval_eval(e, c);
+        }
+        else {
+            eval_count--;
+            depth--;
+            x = lval_apply_sexpr(e, t->v);
+            if (eval_count == base) {
+                return x;
+            }
+            // Calls may have grown the stack and moved it
+            t = &eval_frames[eval_count - 1];
+        }
+
+        if (x->type == LVAL_ERR) {
+            break;
+        }
+        t->v->cell[t->i++] = x;
+        // A special form is applied to the rest of its cells as written
+        if (t->i == 1 && x->type == LVAL_FUN && x->special) {
+            t->i = t->v->count;
+        }
+    }
+
+    // An error is the value of every S-expression enclosing it
+    while (eval_count > base) {
+        eval_count--;
+        depth--;
+        lval_delete(eval_frames[eval_count].v);
+    }
+    return x;
+}
+
 lval* lval_eval(lenv* e, lval* v) {
     if (v->type == LVAL_SYM) {
-        lval* x = lenv_get(e, v);
+        // A resolved formal is an indexed load from the current frame
+        int s = v->slot;
+        lval* x = (s >= 0 && s < e->count && e->syms[s] == v->sym) ?
+            lval_copy(e->vals[s]) : lenv_get_cached(e, v);
         lval_delete(v);
         return x;
     }
     if (v->type == LVAL_SEXPR) {
-        return lval_eval_sexpr(e, v);
+        lgc_enter();
+        lval* x = lval_eval_sexpr(e, v);
+        lgc_leave();
+        return x;
     }
     return v;
 }
 
+/* Evaluate f's body in e, which binds its formals. */
+static lval* lval_eval_body(lenv* e, lval* f) {
+    if (f->code) {
+        return lcode_run(e, f->code);
+    }
+    lval* body = lval_unshare(lval_copy(f->body));
+    body->type = LVAL_SEXPR;
+    return lval_eval(e, body);
+}
+
+/* Run lambda f's body in frame, which binds its formals, and pop it. */
+static lval* lval_run_frame(lenv* frame, lval* f) {
+    if (f->code) {
+        // Pops frame, or whatever frame tail calls have replaced it with
+        return lcode_run_frame(frame, f->code);
+    }
+    lval* result = lval_eval_body(frame, f);
+    lframe_pop(frame);
+    return result;
+}
+
+/* A call that supplies every fixed formal binds into an activation record
+ * on the interpreter's stack rather than a copy of the lambda's frame. The
+ * record holds any bindings captured by partial application, then the
+ * formals in order, so resolved slots (see lval_resolve) line up.
+ */
+static lval* lval_call_frame(lenv* e, lval* f, lval* a) {
+    if (!f->variadic && a->count > f->arity) {
+        lval* err = lval_err("Function passed too many arguments." \
+                             " Got %i, Expected %i",
+                             a->count, f->formals->count);
+        lval_delete(a);
+        return err;
+    }
+    return lval_run_frame(lval_bind_frame(e, f, a, 0), f);
+}
+
+/* Push f's activation record above par, with room for extra more
+ * bindings, and bind its fixed formals to the first arity values in args,
+ * taking them over. A variadic f's rest is left to the caller to bind.
+ */
+lenv* lval_push_frame(lenv* par, lval* f, lval** args, int extra) {
+    lenv* c = f->env;
+    lenv* frame = lframe_push(par, c->count + f->arity + f->variadic + extra);
+    for (int i = 0; i < c->count; i++) {
+        lenv_bind(frame, c->syms[i], lval_copy(c->vals[i]));
+    }
+    for (int i = 0; i < f->arity; i++) {
+        lenv_bind(frame, f->formals->cell[i]->sym, args[i]);
+    }
+    return frame;
+}
+
+/* lval_push_frame with the arguments in a, which must supply every fixed
+ * formal and, unless f is variadic, no more. Consumes a.
+ */
+lenv* lval_bind_frame(lenv* par, lval* f, lval* a, int extra) {
+    for (int i = 0; i < f->arity; i++) {
+        lval_copy(a->cell[i]);
+    }
+    lenv* frame = lval_push_frame(par, f, a->cell, extra);
+    if (f->variadic) {
+        for (int i = 0; i < f->arity; i++) {
+            lval_delete(lval_pop(a, 0));
+        }
+        lenv_bind(frame, f->formals->cell[f->arity + 1]->sym,
+                  builtin_list(par, a));
+    }
+    else {
+        lval_delete(a);
+    }
+    return frame;
+}
+
+/* Call f, a lambda taking exactly arity arguments, on the values in args
+ * without building an argument list. Takes over the arguments.
+ */
+lval* lval_call_args(lenv* e, lval* f, lval** args) {
+    if (depth >= max_depth) {
+        for (int i = 0; i < f->arity; i++) {
+            lval_delete(args[i]);
+        }
+        return lval_depth_err();
+    }
+    depth++;
+    lval* result = lval_run_frame(lval_push_frame(e, f, args, 0), f);
+    depth--;
+    return result;
+}
+
+static lval* lval_call_lambda(lenv* e, lval* f, lval* a);
+
 lval* lval_call(lenv* e, lval* f, lval* a) {
-    if (f->builtin) {
-        return f->builtin(e, a);
+    if (depth >= max_depth) {
+        lval_delete(a);
+        return lval_depth_err();
     }
+    depth++;
+    lval* result = f->builtin ? f->builtin(e, a) : lval_call_lambda(e, f, a);
+    depth--;
+    return result;
+}
+
+static lval* lval_call_lambda(lenv* e, lval* f, lval* a) {
+    if (f->arity >= 0 && a->count >= f->arity) {
+        return lval_call_frame(e, f, a);
+    }
+
+    // Binding consumes formals and fills env, so work on a private copy of
+    // the function. f itself may be shared with an environment.
+    f = lval_dup(f);
+    f->formals = lval_unshare(f->formals);
+    f->env = lenv_unshare(f->env);
 
     int given = a->count;
     int total = f->formals->count;
@@ -326,21 +978,27 @@ lval* lval_call(lenv* e, lval* f, lval* a) {
     while(a->count) {
         if (f->formals->count == 0) {
             lval_delete(a);
+            lval_delete(f);
             return lval_err("Function passed too many arguments." \
                             " Got %i, Expected %i",
                             given, total);
         }
         lval* sym = lval_pop(f->formals, 0);
-        if (strcmp("&", sym->sym) == 0) {
+        if (sym->sym == lsym_intern("&")) {
             if (f->formals->count != 1) {
                 lval_delete(a);
+                lval_delete(f);
+                lval_delete(sym);
                 return lval_err("Function format invalid. Symbol '&' not " \
                                 "followed by single symbol");
             }
             lval* nsym = lval_pop(f->formals, 0);
-            lenv_put(f->env, nsym, builtin_list(e, a));
+            lval* rest = builtin_list(e, a);
+            lenv_put(f->env, nsym, rest);
+            lval_delete(rest);
             lval_delete(nsym);
             lval_delete(sym);
+            a = NULL;
             break;
         }
         else {
@@ -352,15 +1010,20 @@ lval* lval_call(lenv* e, lval* f, lval* a) {
         }
     }
 
-    lval_delete(a);
+    if (a) {
+        lval_delete(a);
+    }
     if (f->formals->count == 0) {
         f->env->par = e;
-        return builtin_eval(f->env, lval_add(lval_sexpr(), lval_copy(f->body)));
+        lval* result = lval_eval_body(f->env, f);
+        lval_delete(f);
+        return result;
     }
-    else if (strcmp(f->formals->cell[0]->sym, "&") == 0) {
+    else if (f->formals->cell[0]->sym == lsym_intern("&")) {
         // Only remaining formals is &xs. Because &xs is optional, this means
         // that this should be evaluated.
         if (f->formals->count != 2) {
+            lval_delete(f);
             return lval_err("Function format invalid. Symbol '&' not followed "\
                             "by single symbol.");
         }
@@ -372,20 +1035,71 @@ lval* lval_call(lenv* e, lval* f, lval* a) {
         lenv_put(f->env, sym, val);
         lval_delete(sym);
         lval_delete(val);
-        return builtin_eval(f->env, lval_add(lval_sexpr(), lval_copy(f->body)));
+        f->env->par = e;
+        lval* result = lval_eval_body(f->env, f);
+        lval_delete(f);
+        return result;
     }
 
-    return lval_copy(f);
+    // Partially applied: hand back a new, as yet unnamed function with its
+    // bound arguments
+    f->env->name = NULL;
+    lval_fun_shape(f);
+    return f;
 }
 
 lval* lval_pop(lval* v, int i) {
+    lcells* b = v->buf;
     lval* x = v->cell[i];
-    /* Shift the memory following the item at "i" over the top of it */
-    memmove(&v->cell[i], &v->cell[i + 1], sizeof(lval*) * (v->count - i - 1));
 
-    v->count--;
+    if (i == 0 || i == v->count - 1) {
+        // Popping either end only narrows the view. The buffer's reference
+        // moves to the caller if nothing else can see the slot.
+        if (b->refs == 1 && &v->cell[i] == &b->items[b->lo]) {
+            b->lo++;
+        }
+        else if (b->refs == 1 && &v->cell[i] == &b->items[b->hi - 1]) {
+            b->hi--;
+        }
+        else {
+            x = lval_copy(x);
+        }
+        if (i == 0) {
+            v->cell++;
+        }
+        v->count--;
+    }
+    else {
+        lval_own_cells(v, 0);
+        b = v->buf;
+        x = v->cell[i];
+        /* Shift the memory following the item at "i" over the top of it */
+        memmove(&v->cell[i], &v->cell[i + 1],
+                sizeof(lval*) * (v->count - i - 1));
+        v->count--;
+        b->hi--;
+    }
 
-    v->cell = realloc(v->cell, sizeof(lval*) * v->count);
+    if (v->count == 0) {
+        lcells_release(v->buf);
+        v->buf = NULL;
+        v->cell = NULL;
+    }
+    else if (v->buf->refs == 1 && v->buf->cap > LVAL_MIN_CAP &&
+             v->count < v->buf->cap / 4) {
+        // Give memory back only once the list is down to a quarter of its
+        // capacity, so alternating pops and adds never thrash realloc.
+        int cap = v->buf->cap / 2;
+        lval_own_cells(v, 0);
+        b = v->buf;
+        memmove(b->items, v->cell, sizeof(lval*) * v->count);
+        b->lo = 0;
+        b->hi = v->count;
+        b = realloc(b, sizeof(lcells) + sizeof(lval*) * cap);
+        b->cap = cap;
+        v->buf = b;
+        v->cell = b->items;
+    }
     return x;
 }
 
@@ -396,15 +1110,51 @@ lval* lval_take(lval* v, int i) {
 }
 
 lval* lval_join(lval* x, lval* y) {
-    while (y->count) {
-        x = lval_add(x, lval_pop(y, 0));
+    for (int i = 0; i < y->count; i++) {
+        x = lval_add(x, lval_copy(y->cell[i]));
     }
     lval_delete(y);
     return x;
 }
 
-int lval_eq(lval* x, lval* y) {
-    if (x->type != y->type) {
+/* Element i of a Q-Expression or Cons-List, stepping *c down the spine. */
+static lval* lval_seq_next(lval* v, lval** c, int i) {
+    if (v->type == LVAL_CONS) {
+        lval* x = (*c)->car;
+        *c = (*c)->cdr;
+        return x;
+    }
+    return v->cell[i];
+}
+
+static int lval_seq_len(lval* v) {
+    return v->type == LVAL_CONS ? (int)v->len : v->count;
+}
+
+/* Pairs of values lval_eq has still to compare. */
+static lval** eq_pending = NULL;
+static int eq_count = 0;
+static int eq_cap = 0;
+
+static void lval_eq_push(lval* x, lval* y) {
+    if (eq_count + 2 > eq_cap) {
+        eq_cap = eq_cap ? eq_cap * 2 : 64;
+        eq_pending = realloc(eq_pending, sizeof(lval*) * eq_cap);
+    }
+    eq_pending[eq_count++] = x;
+    eq_pending[eq_count++] = y;
+}
+
+/* Compare x and y themselves, queueing up their elements for lval_eq. */
+static int lval_eq_node(lval* x, lval* y) {
+    if (x == y) {
+        return 1;
+    }
+    // A Cons-List and a Q-Expression with the same elements are equal, so
+    // idioms like (== xs {}) keep working whichever form xs is in.
+    int xs = x->type == LVAL_CONS || x->type == LVAL_QEXPR;
+    int ys = y->type == LVAL_CONS || y->type == LVAL_QEXPR;
+    if (x->type != y->type && !(xs && ys)) {
         return 0;
     }
     switch (x->type) {
@@ -413,30 +1163,51 @@ int lval_eq(lval* x, lval* y) {
     case LVAL_ERR:
         return (strcmp(x->err, y->err) == 0);
     case LVAL_SYM:
-        return (strcmp(x->sym, y->sym) == 0);
+        return x->sym == y->sym;
     case LVAL_STR:
         return (strcmp(x->str, y->str) == 0);
     case LVAL_FUN:
         if (y->builtin || x->builtin) {
             return y->builtin == x->builtin;
         }
-        return lval_eq(y->formals, x->formals) && \
-            lval_eq(y->body, x->body);
+        lval_eq_push(x->formals, y->formals);
+        lval_eq_push(x->body, y->body);
+        return 1;
     case LVAL_SEXPR:
     case LVAL_QEXPR:
-        if (x->count != y->count) {
+    case LVAL_CONS: {
+        int n = lval_seq_len(x);
+        if (n != lval_seq_len(y)) {
             return 0;
         }
-        for (int i = 0; i < x->count; i++) {
-            if (lval_eq(x->cell[i], y->cell[i]) == 0) {
-                return 0;
-            }
+        lval* cx = x;
+        lval* cy = y;
+        for (int i = 0; i < n && cx != cy; i++) {
+            // Once the spines meet the rest is shared
+            lval* a = lval_seq_next(x, &cx, i);
+            lval* b = lval_seq_next(y, &cy, i);
+            lval_eq_push(a, b);
         }
         return 1;
     }
+    }
     return 0;
 }
 
+/* Walks both values with an explicit stack, so deeply nested lists can't
+ * overflow the C stack.
+ */
+int lval_eq(lval* x, lval* y) {
+    int base = eq_count;
+    int eq = lval_eq_node(x, y);
+    while (eq && eq_count > base) {
+        eq_count -= 2;
+        eq = lval_eq_node(eq_pending[eq_count], eq_pending[eq_count + 1]);
+    }
+    eq_count = base;
+    return eq;
+}
+
 lval* builtin_op(lenv* e, lval* v, char* op) {
     for (int i = 0; i < v->count; i++) {
         LASSERT(v, (v->cell[i]->type == LVAL_NUM),
@@ -444,40 +1215,40 @@ lval* builtin_op(lenv* e, lval* v, char* op) {
                 ltype_name(v->cell[i]->type))
     }
 
-    lval* x = lval_pop(v, 0);
-    if ((strcmp(op, "-") == 0) && v->count == 0) {
-        x->num = -1 * x->num;
+    // Accumulate in a C long so intermediate results never need an lval of
+    // their own; only the final answer is boxed (or taken from the cache).
+    long x = v->cell[0]->num;
+    if ((strcmp(op, "-") == 0) && v->count == 1) {
+        x = -1 * x;
     }
 
-    while (v->count > 0) {
-        lval* y = lval_pop(v, 0);
+    for (int i = 1; i < v->count; i++) {
+        long y = v->cell[i]->num;
 
         if (strcmp(op, "+") == 0) {
-            x->num += y->num;
+            x += y;
         }
         if (strcmp(op, "-") == 0) {
-            x->num -= y->num;
+            x -= y;
         }
         if (strcmp(op, "*") == 0) {
-            x->num *= y->num;
+            x *= y;
         }
         if (strcmp(op, "/") == 0) {
-            if (y->num == 0) {
-                lval_delete(x);
-                lval_delete(y);
+            if (y == 0) {
+                lval_delete(v);
                 return lval_err("Division by Zero");
             }
             else {
-                x->num = x->num / y->num;
+                x = x / y;
             }
         }
         if (strcmp(op, "%") == 0) {
-            x->num = x->num % y->num;
+            x = x % y;
         }
-        lval_delete(y);
     }
     lval_delete(v);
-    return x;
+    return lval_num(x);
 }
 
 lval* builtin_add(lenv* e, lval* a) { return builtin_op(e, a, "+"); }
@@ -486,41 +1257,93 @@ lval* builtin_mul(lenv* e, lval* a) { return builtin_op(e, a, "*"); }
 lval* builtin_div(lenv* e, lval* a) { return builtin_op(e, a, "/"); }
 lval* builtin_modulo(lenv* e, lval* a) { return builtin_op(e, a, "%"); }
 
+lval* fixed_add(lenv* e, lval** a) {
+    if (a[0]->type != LVAL_NUM || a[1]->type != LVAL_NUM) {
+        return NULL;
+    }
+    return lval_num(a[0]->num + a[1]->num);
+}
+
+lval* fixed_sub(lenv* e, lval** a) {
+    if (a[0]->type != LVAL_NUM || a[1]->type != LVAL_NUM) {
+        return NULL;
+    }
+    return lval_num(a[0]->num - a[1]->num);
+}
+
+lval* fixed_head(lenv* e, lval** a) {
+    lval* x = a[0];
+    if (x->type == LVAL_CONS) {
+        return x->len ? lval_cons(lval_copy(x->car), lval_nil()) : NULL;
+    }
+    if (x->type == LVAL_QEXPR) {
+        return x->count ? lval_add(lval_qexpr(), lval_copy(x->cell[0])) : NULL;
+    }
+    if (x->type == LVAL_STR) {
+        char head[2] = { x->str[0], '\0' };
+        return lval_str(head);
+    }
+    return NULL;
+}
+
 lval* builtin_head(lenv* e, lval* a) {
     LASSERT_SIZE(a, 1, "Head function passed too many arguments");
-    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR || a->cell[0]->type == LVAL_STR),
+    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR || a->cell[0]->type == LVAL_STR
+                || a->cell[0]->type == LVAL_CONS),
             "Head function requires a %s or %s not a %s",
             ltype_name(LVAL_QEXPR), ltype_name(LVAL_STR),
             ltype_name(a->cell[0]->type));
+    if (a->cell[0]->type == LVAL_CONS) {
+        LASSERT(a, (a->cell[0]->len != 0), "Head function passed {}");
+    }
     if (a->cell[0]->type == LVAL_QEXPR) {
         LASSERT_NONEMPTY(a, "Head function passed {}");
-        lval* v = lval_take(a, 0);
-        while (v->count > 1) {
-            lval_pop(v, 1);
-        }
-        return v;
     }
-    char* head = malloc(1);
-    lval* v = lval_str(strncpy(head, a->cell[0]->str, 1));
+    lval* v = fixed_head(e, a->cell);
     lval_delete(a);
     return v;
 }
 
+lval* fixed_tail(lenv* e, lval** a) {
+    lval* x = a[0];
+    if (x->type == LVAL_CONS) {
+        // The rest of the list already exists; hand it out as is
+        return x->len ? lval_copy(x->cdr) : NULL;
+    }
+    if (x->type == LVAL_QEXPR) {
+        if (x->count == 0) {
+            return NULL;
+        }
+        // Shares x's cells, so this is one node whatever the length
+        lval* v = lval_unshare(lval_copy(x));
+        lval_delete(lval_pop(v, 0));
+        return v;
+    }
+    if (x->type == LVAL_STR) {
+        return lval_str(x->str[0] ? x->str + 1 : "");
+    }
+    return NULL;
+}
+
 lval* builtin_tail(lenv* e, lval* a) {
     LASSERT_SIZE(a, 1, "Tail function passed too many arguments");
-    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR || a->cell[0]->type == LVAL_STR),
+    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR || a->cell[0]->type == LVAL_STR
+                || a->cell[0]->type == LVAL_CONS),
             "Tail function requires a %s or %s not a %s",
             ltype_name(LVAL_QEXPR), ltype_name(LVAL_STR),
             ltype_name(a->cell[0]->type));
+    if (a->cell[0]->type == LVAL_CONS) {
+        LASSERT(a, (a->cell[0]->len != 0), "Tail function passed {}");
+    }
     if (a->cell[0]->type == LVAL_QEXPR) {
         LASSERT_NONEMPTY(a, "Tail function passed {}");
 
-        lval* v = lval_take(a, 0);
+        // Reuse the list itself when nothing else holds it
+        lval* v = lval_unshare(lval_take(a, 0));
         lval_delete(lval_pop(v, 0));
         return v;
     }
-    char* tail = malloc(strlen(a->cell[0]->str));
-    lval* v = lval_str(strcpy(tail, (a->cell[0]->str + 1)));
+    lval* v = fixed_tail(e, a->cell);
     lval_delete(a);
     return v;
 }
@@ -529,31 +1352,118 @@ lval* builtin_list(lenv* e, lval* a) {
     LASSERT(a, (a->type == LVAL_SEXPR),
             "List function requires a %s not a %s",
             ltype_name(LVAL_SEXPR), ltype_name(a->type));
+    a = lval_unshare(a);
     a->type = LVAL_QEXPR;
     return a;
 }
 
 lval* builtin_eval(lenv* e, lval* a) {
     LASSERT_SIZE(a, 1, "Eval function passed wrong number of arguments");
-    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR),
+    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR
+                || a->cell[0]->type == LVAL_CONS),
             "Eval function requires a %s not a %s",
             ltype_name(LVAL_QEXPR), ltype_name(a->cell[0]->type));
 
-    lval* x = lval_take(a, 0);
+    if (a->cell[0]->type == LVAL_CONS) {
+        lval* c = lval_take(a, 0);
+        lval* x = lval_sexpr();
+        lval_reserve(x, c->len);
+        for (lval* p = c; p->len; p = p->cdr) {
+            lval_add(x, lval_copy(p->car));
+        }
+        lval_delete(c);
+        return lval_eval(e, x);
+    }
+
+    lval* x = lval_unshare(lval_take(a, 0));
     x->type = LVAL_SEXPR;
     return lval_eval(e, x);
 }
 
+/* Joined Cons-Lists share the last argument when it is one; only the
+ * earlier spines are copied, and Q-Expressions among the arguments are
+ * converted. */
+static lval* builtin_join_cons(lenv* e, lval* a) {
+    lval* x = lval_nil();
+    if (a->cell[a->count - 1]->type == LVAL_CONS) {
+        x = lval_pop(a, a->count - 1);
+    }
+    while (a->count) {
+        lval* y = lval_pop(a, a->count - 1);
+
+        // Collect y's elements so the new spine can be built back to front
+        int n = lval_seq_len(y);
+        lval** items = malloc(sizeof(lval*) * n);
+        lval* c = y;
+        for (int i = 0; i < n; i++) {
+            items[i] = lval_seq_next(y, &c, i);
+        }
+        while (n--) {
+            x = lval_cons(lval_copy(items[n]), x);
+        }
+        free(items);
+        lval_delete(y);
+    }
+    lval_delete(a);
+    return x;
+}
+
+/* Evaluate a Q-Expression in a fork of the global environment, so it sees
+ * every global but whatever it defines is thrown away afterwards.
+ */
+lval* builtin_sandbox(lenv* e, lval* a) {
+    LASSERT_SIZE(a, 1, "Sandbox function passed wrong number of arguments");
+    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR),
+            "Sandbox function requires a %s not a %s",
+            ltype_name(LVAL_QEXPR), ltype_name(a->cell[0]->type));
+
+    while (e->par) {
+        e = e->par;
+    }
+    lenv* s = lenv_fork(e);
+    lgc_add_root_env(s);
+
+    lval* x = lval_unshare(lval_take(a, 0));
+    x->type = LVAL_SEXPR;
+    lval* result = lval_eval(s, x);
+
+    lgc_remove_root_env(s);
+    lenv_delete(s);
+    return result;
+}
+
+/* Q-Expressions and Cons-Lists may be mixed; the result is the type of
+ * the first argument.
+ */
 lval* builtin_join(lenv* e, lval* a) {
     for (int i = 0; i < a->count; i++) {
-        LASSERT(a, (a->cell[i]->type == LVAL_QEXPR),
-                "Join argument %d is not a %s. It is a %s",
-                i + 1, ltype_name(LVAL_QEXPR), ltype_name(a->cell[i]->type));
+        LASSERT(a, (a->cell[i]->type == LVAL_QEXPR
+                    || a->cell[i]->type == LVAL_CONS),
+                "Join argument %d is not a %s or %s. It is a %s",
+                i + 1, ltype_name(LVAL_QEXPR), ltype_name(LVAL_CONS),
+                ltype_name(a->cell[i]->type));
+    }
+    if (a->count && a->cell[0]->type == LVAL_CONS) {
+        return builtin_join_cons(e, a);
     }
 
-    lval* x = lval_pop(a, 0);
+    lval* x = lval_unshare(lval_pop(a, 0));
+    int total = x->count;
+    for (int i = 0; i < a->count; i++) {
+        total += lval_seq_len(a->cell[i]);
+    }
+    lval_reserve(x, total);
     while (a->count) {
-        x = lval_join(x, lval_pop(a, 0));
+        lval* y = lval_pop(a, 0);
+        if (y->type == LVAL_QEXPR) {
+            x = lval_join(x, y);
+            continue;
+        }
+        lval* c = y;
+        for (int i = 0; i < y->len; i++) {
+            x = lval_add(x, lval_copy(lval_seq_next(y, &c, i)));
+        }
+        lval_delete(y);
     }
     lval_delete(a);
     return x;
@@ -561,42 +1471,138 @@ lval* builtin_join(lenv* e, lval* a) {
 
 lval* builtin_cons(lenv* e, lval* a) {
     LASSERT_SIZE(a, 2, "Cons not called with two arguments");
-    LASSERT(a, (a->cell[1]->type == LVAL_QEXPR),
+    LASSERT(a, (a->cell[1]->type == LVAL_QEXPR
+                || a->cell[1]->type == LVAL_CONS),
             "Second argument to Cons must be a %s not a %s",
             ltype_name(LVAL_QEXPR), ltype_name(a->cell[1]->type));
 
     lval* n = lval_pop(a, 0);
     lval* v = lval_pop(a, 0);
+    lval_delete(a);
+    if (v->type == LVAL_CONS) {
+        return lval_cons(n, v);
+    }
+    v = lval_unshare(v);
 
-    v->count++;
-    v->cell = realloc(v->cell, sizeof(lval*) * v->count);
-    memmove(&v->cell[1], &v->cell[0], sizeof(lval*) * (v->count - 1));
+    lcells* b = v->buf;
+    if (b && b->refs == 1 && v->cell == &b->items[b->lo] && b->lo > 0) {
+        // Reuse a slot freed by an earlier pop from the front
+        b->lo--;
+        v->cell--;
+    }
+    else {
+        lval_own_cells(v, v->count < LVAL_MIN_CAP ?
+                       LVAL_MIN_CAP : v->count * 2);
+        b = v->buf;
+        memmove(&v->cell[1], &v->cell[0], sizeof(lval*) * v->count);
+        b->hi++;
+    }
     v->cell[0] = n;
+    v->count++;
     return v;
 }
 
+lval* fixed_len(lenv* e, lval** a) {
+    if (a[0]->type == LVAL_CONS) {
+        return lval_num(a[0]->len);
+    }
+    return a[0]->type == LVAL_QEXPR ? lval_num(a[0]->count) : NULL;
+}
+
 lval* builtin_len(lenv* e, lval* a) {
     LASSERT_SIZE(a, 1, "len can only be called with one argument");
-    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR),
+    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR
+                || a->cell[0]->type == LVAL_CONS),
             "len requires a %s not a %s",
             ltype_name(LVAL_QEXPR), ltype_name(a->cell[0]->type));
 
-    lval* v = lval_num(a->cell[0]->count);
+    lval* v = fixed_len(e, a->cell);
     lval_delete(a);
     return v;
 }
 
+lval* builtin_clist(lenv* e, lval* a) {
+    LASSERT_SIZE(a, 1, "clist can only be called with one argument");
+    LASSERT(a, (a->cell[0]->type == LVAL_QEXPR),
+            "clist requires a %s not a %s",
+            ltype_name(LVAL_QEXPR), ltype_name(a->cell[0]->type));
+
+    lval* q = lval_take(a, 0);
+    lval* v = lval_nil();
+    for (int i = q->count - 1; i >= 0; i--) {
+        v = lval_cons(lval_copy(q->cell[i]), v);
+    }
+    lval_delete(q);
+    return v;
+}
+
 lval* builtin_init(lenv* e, lval* a) {
     LASSERT_SIZE(a, 1, "init can only be called with one argument");
     LASSERT(a, (a->cell[0]->type == LVAL_QEXPR),
             "init requires a %s not a %s",
             ltype_name(LVAL_QEXPR), ltype_name(a->cell[0]->type));
 
-    lval* v = lval_take(a, 0);
+    lval* v = lval_unshare(lval_take(a, 0));
     lval_delete(lval_pop(v, v->count - 1));
     return v;
 }
 
+/* Replace references to constants in S-Expression positions of the copy
+ * of a lambda body its code is compiled from with their values, so
+ * running them needs no lookup. Quoted lists inside the body may be data
+ * rather than code and are left alone. Only values that evaluate to
+ * themselves are substituted.
+ *
+ * This makes constants lexical. A constant can't be rebound or used as a
+ * formal from then on, but a lambda defined before defconst may still
+ * have the name as a formal and bind it when called. The lambdas it calls
+ * still see the constant wherever they were defined after it, while ones
+ * defined before look the name up and see that binding.
+ */
+static lval* lval_inline_consts(lenv* e, lval* v) {
+    if (v->type == LVAL_SYM) {
+        if (!lenv_is_const(e, v->sym)) {
+            return v;
+        }
+        lval* x = lenv_get(e, v);
+        if (x->type == LVAL_ERR || x->type == LVAL_SYM ||
+            x->type == LVAL_SEXPR) {
+            lval_delete(x);
+            return v;
+        }
+        lval_delete(v);
+        return x;
+    }
+    if (v->type != LVAL_SEXPR && v->type != LVAL_QEXPR) {
+        return v;
+    }
+
+    for (int i = 0; i < v->count; i++) {
+        lval* c = v->cell[i];
+        if (c->type == LVAL_QEXPR) {
+            continue;
+        }
+        c = lval_inline_consts(e, lval_copy(c));
+        if (c == v->cell[i]) {
+            lval_delete(c);
+            continue;
+        }
+        // Copy on write: the body may be shared with a list the user holds
+        v = lval_unshare(v);
+        lval_own_cells(v, 0);
+        lval_delete(v->cell[i]);
+        v->cell[i] = c;
+    }
+    return v;
+}
+
+/* Let a lambda remember the first name it is defined under, for printing. */
+static void lval_name(lval* v, lval* sym) {
+    if (v->type == LVAL_FUN && v->builtin == NULL && v->env->name == NULL) {
+        v->env->name = sym->sym;
+    }
+}
+
 lval* builtin_var(lenv* e, lval* a, char* func) {
     LASSERT(a, (a->cell[0]->type == LVAL_QEXPR),
             "def requires a %s not a %s",
@@ -611,9 +1617,18 @@ lval* builtin_var(lenv* e, lval* a, char* func) {
 
     LASSERT(a, (syms->count == a->count-1),
             "def cannot define incorrect number of values to symbols");
+    for (int i = 0; i < syms->count; i++) {
+        LASSERT(a, !lenv_is_const(e, syms->cell[i]->sym),
+                "Cannot redefine constant %s", syms->cell[i]->sym);
+    }
 
     for (int i = 0; i < syms->count; i++) {
-        if (strcmp(func, "def") == 0) {
+        if (strcmp(func, "defconst") == 0) {
+            lval_name(a->cell[i + 1], syms->cell[i]);
+            lenv_def_const(e, syms->cell[i], a->cell[i + 1]);
+        }
+        else if (strcmp(func, "def") == 0) {
+            lval_name(a->cell[i + 1], syms->cell[i]);
             lenv_def(e, syms->cell[i], a->cell[i + 1]);
         }
         else if (strcmp(func, "=") == 0) {
@@ -628,6 +1643,10 @@ lval* builtin_def (lenv* e, lval* a) {
     return builtin_var(e, a, "def");
 }
 
+lval* builtin_defconst(lenv* e, lval* a) {
+    return builtin_var(e, a, "defconst");
+}
+
 lval* builtin_put (lenv* e, lval* a) {
     return builtin_var(e, a, "=");
 }
@@ -644,11 +1663,15 @@ lval* builtin_lambda(lenv* e, lval* a) {
         LASSERT(a, (a->cell[0]->cell[i]->type == LVAL_SYM),
                 "Cannot define non-symbol. Got %s, Expected %s.",
                 ltype_name(a->cell[0]->cell[i]->type), ltype_name(LVAL_SYM));
+        LASSERT(a, !lenv_is_const(e, a->cell[0]->cell[i]->sym),
+                "Cannot use constant %s as a formal",
+                a->cell[0]->cell[i]->sym);
     }
 
     lval* formals = lval_pop(a, 0);
     lval* body = lval_pop(a, 0);
-    return lval_lambda(formals, body);
+    lval_delete(a);
+    return lval_lambda_in(e, formals, body);
 }
 
 lval* builtin_fun(lenv* e, lval* a) {
@@ -659,13 +1682,32 @@ lval* builtin_fun(lenv* e, lval* a) {
     LASSERT_ARG_TYPE(a, 1, LVAL_QEXPR,
                      "Lambda second argument isn't %s. It is %s",
                      ltype_name(LVAL_QEXPR), ltype_name(a->cell[1]->type));
-    lval* args = lval_pop(a, 0);
+    for (int i = 0; i < a->cell[0]->count; i++) {
+        LASSERT(a, (a->cell[0]->cell[i]->type == LVAL_SYM),
+                "Cannot define non-symbol. Got %s, Expected %s.",
+                ltype_name(a->cell[0]->cell[i]->type), ltype_name(LVAL_SYM));
+    }
+    LASSERT(a, (a->cell[0]->count > 0), "fun requires a name");
+    LASSERT(a, !lenv_is_const(e, a->cell[0]->cell[0]->sym),
+            "Cannot redefine constant %s", a->cell[0]->cell[0]->sym);
+    for (int i = 1; i < a->cell[0]->count; i++) {
+        LASSERT(a, !lenv_is_const(e, a->cell[0]->cell[i]->sym),
+                "Cannot use constant %s as a formal", a->cell[0]->cell[i]->sym);
+    }
+    lval* args = lval_unshare(lval_pop(a, 0));
     lval* name = lval_pop(args, 0);
     lval* body = lval_pop(a, 0);
 
-    lval* func = lval_lambda(args, body);
+    lval* func = lval_lambda_in(e, args, body);
+    if (func->type == LVAL_ERR) {
+        lval_delete(name);
+        lval_delete(a);
+        return func;
+    }
+    lval_name(func, name);
     lenv_def(e, name, func);
 
+    lval_delete(name);
     lval_delete(a);
     return func;
 }
@@ -693,6 +1735,13 @@ lval* builtin_lt(lenv* e, lval* a) { return builtin_ord(e, a, "<");  }
 lval* builtin_ge(lenv* e, lval* a) { return builtin_ord(e, a, ">="); }
 lval* builtin_le(lenv* e, lval* a) { return builtin_ord(e, a, "<="); }
 
+lval* fixed_lt(lenv* e, lval** a) {
+    if (a[0]->type != LVAL_NUM || a[1]->type != LVAL_NUM) {
+        return NULL;
+    }
+    return lval_num(a[0]->num < a[1]->num);
+}
+
 lval* builtin_cmp(lenv* e, lval* a, char* op) {
     LASSERT_SIZE(a, 2, "Comparison operator %s requires two arguments not %i",
                  op, a->count);
@@ -719,38 +1768,94 @@ lval* builtin_cmp(lenv* e, lval* a, char* op) {
 lval* builtin_eq(lenv* e, lval* a) { return builtin_cmp(e, a, "=="); }
 lval* builtin_ne(lenv* e, lval* a) { return builtin_cmp(e, a, "!="); }
 
+lval* fixed_eq(lenv* e, lval** a) {
+    return lval_num(lval_eq(a[0], a[1]));
+}
+
+/* if, or, and, cond, when and unless are special forms (see
+ * lenv_add_special): their operands arrive unevaluated, and each is
+ * evaluated only when the form needs its value.
+ */
+
+/* Evaluate operand i of a special form in place, returning its value. */
+static lval* lval_eval_operand(lenv* e, lval* a, int i) {
+    lval_own_cells(a, 0);
+    a->cell[i] = lval_eval(e, a->cell[i]);
+    return a->cell[i];
+}
+
+/* Evaluate a branch of a special form. One written in braces is run as an
+ * S-expression, as if has always done. Any other expression is evaluated,
+ * and its value run in turn if it is a Q-Expression, so branches passed
+ * as values behave as they did when if evaluated its arguments.
+ */
+static lval* lval_eval_branch(lenv* e, lval* v) {
+    if (v->type != LVAL_QEXPR) {
+        v = lval_eval(e, v);
+        if (v->type != LVAL_QEXPR) {
+            return v;
+        }
+    }
+    v = lval_unshare(v);
+    v->type = LVAL_SEXPR;
+    return lval_eval(e, v);
+}
+
+/* The error for condition i of form, counting operands or clauses as the
+ * form does, when it evaluated to type rather than a number. Shared with
+ * the forms compiled in place (see lcode.h).
+ */
+lval* lval_cond_err(lbuiltin form, int i, int type) {
+    if (form == builtin_if) {
+        return lval_err("First argument to If must evaluate to a %s",
+                        ltype_name(LVAL_NUM));
+    }
+    if (form == builtin_when || form == builtin_unless) {
+        return lval_err("First argument to %s must evaluate to a %s not a %s",
+                        form == builtin_when ? "when" : "unless",
+                        ltype_name(LVAL_NUM), ltype_name(type));
+    }
+    if (form == builtin_cond) {
+        return lval_err("Test of clause %i does not evaluate to a %s but a %s",
+                        i, ltype_name(LVAL_NUM), ltype_name(type));
+    }
+    return lval_err("Condition %i does not evaluate to a %s but a %s",
+                    i, ltype_name(LVAL_NUM), ltype_name(type));
+}
+
+/* Evaluate operand i of form in place as a condition. NULL when it is a
+ * number; otherwise a is deleted and the error returned.
+ */
+static lval* lval_eval_cond(lenv* e, lval* a, int i, lbuiltin form) {
+    lval* x = lval_eval_operand(e, a, i);
+    if (x->type == LVAL_NUM) {
+        return NULL;
+    }
+    if (x->type == LVAL_ERR) {
+        return lval_take(a, i);
+    }
+    lval* err = lval_cond_err(form, i, x->type);
+    lval_delete(a);
+    return err;
+}
+
 lval* builtin_if(lenv* e, lval* a) {
     LASSERT_SIZE(a, 3, "If requires three arguments. One for condition, one "\
                  "for if condition is True and finally one for if condition "\
                  "is false");
-    LASSERT_ARG_TYPE(a, 0, LVAL_NUM,
-                     "First argument to If must evaluate to a %s",
-                     ltype_name(LVAL_NUM));
-    LASSERT_ARG_TYPE(a, 1, LVAL_QEXPR,
-                     "Second argument to If must be a %s",
-                     ltype_name(LVAL_QEXPR));
-    LASSERT_ARG_TYPE(a, 2, LVAL_QEXPR,
-                     "Third argument to If must be a %s",
-                     ltype_name(LVAL_QEXPR));
-    a->cell[1]->type = LVAL_SEXPR;
-    a->cell[2]->type = LVAL_SEXPR;
-
-    lval* x = NULL;
-    if (a->cell[0]->num) {
-        x = lval_eval(e, lval_pop(a, 1));
-    }
-    else {
-        x = lval_eval(e, lval_pop(a, 2));
+    lval* err = lval_eval_cond(e, a, 0, builtin_if);
+    if (err) {
+        return err;
     }
-    lval_delete(a);
-    return x;
+    return lval_eval_branch(e, lval_take(a, a->cell[0]->num ? 1 : 2));
 }
 
 lval* builtin_or(lenv* e, lval* a) {
     for (int i = 0; i < a->count; i++) {
-        LASSERT_ARG_TYPE(a, i, LVAL_NUM,
-                         "Condition %i does not evaluate to a %s but a %s",
-                         i, ltype_name(LVAL_NUM), ltype_name(a->cell[i]->type));
+        lval* err = lval_eval_cond(e, a, i, builtin_or);
+        if (err) {
+            return err;
+        }
         if (a->cell[i]->num) {
             lval_delete(a);
             return lval_num(1);
@@ -762,9 +1867,10 @@ lval* builtin_or(lenv* e, lval* a) {
 
 lval* builtin_and(lenv* e, lval* a) {
     for (int i = 0; i < a->count; i++) {
-        LASSERT_ARG_TYPE(a, i, LVAL_NUM,
-                         "Condition %i does not evaluate to a %s but a %s",
-                         i, ltype_name(LVAL_NUM), ltype_name(a->cell[i]->type));
+        lval* err = lval_eval_cond(e, a, i, builtin_and);
+        if (err) {
+            return err;
+        }
         if (a->cell[i]->num == 0) {
             lval_delete(a);
             return lval_num(0);
@@ -774,19 +1880,101 @@ lval* builtin_and(lenv* e, lval* a) {
     return lval_num(1);
 }
 
+/* (cond {test body...} ...): the body of the first clause whose test is
+ * true, run as an S-expression, or the test's value when the clause has
+ * no body. An empty S-expression when no test is true.
+ */
+lval* builtin_cond(lenv* e, lval* a) {
+    for (int i = 0; i < a->count; i++) {
+        if (lval_eval_operand(e, a, i)->type == LVAL_ERR) {
+            return lval_take(a, i);
+        }
+        LASSERT(a, a->cell[i]->type == LVAL_QEXPR && a->cell[i]->count,
+                "Clause %i of cond must be a non-empty %s",
+                i, ltype_name(LVAL_QEXPR));
+
+        lval* clause = lval_unshare(lval_copy(a->cell[i]));
+        lval* test = lval_eval(e, lval_pop(clause, 0));
+        if (test->type == LVAL_NUM && test->num == 0) {
+            lval_delete(test);
+            lval_delete(clause);
+            continue;
+        }
+
+        lval_delete(a);
+        if (test->type == LVAL_ERR) {
+            lval_delete(clause);
+            return test;
+        }
+        if (test->type != LVAL_NUM) {
+            lval* err = lval_cond_err(builtin_cond, i, test->type);
+            lval_delete(test);
+            lval_delete(clause);
+            return err;
+        }
+        if (clause->count == 0) {
+            lval_delete(clause);
+            return test;
+        }
+        lval_delete(test);
+        clause->type = LVAL_SEXPR;
+        return lval_eval(e, clause);
+    }
+    lval_delete(a);
+    return lval_sexpr();
+}
+
+/* when and unless: if the condition holds (fails, for unless), evaluate
+ * the remaining operands as branches in order and return the last value,
+ * or the condition's when there are none. Otherwise an empty
+ * S-expression.
+ */
+static lval* builtin_guard(lenv* e, lval* a, lbuiltin form) {
+    LASSERT(a, a->count > 0, "%s requires a condition",
+            form == builtin_when ? "when" : "unless");
+    lval* err = lval_eval_cond(e, a, 0, form);
+    if (err) {
+        return err;
+    }
+    if (!a->cell[0]->num == (form == builtin_when)) {
+        lval_delete(a);
+        return lval_sexpr();
+    }
+
+    lval* x = lval_pop(a, 0);
+    while (a->count) {
+        lval_delete(x);
+        x = lval_eval_branch(e, lval_pop(a, 0));
+        if (x->type == LVAL_ERR) {
+            break;
+        }
+    }
+    lval_delete(a);
+    return x;
+}
+
+lval* builtin_when(lenv* e, lval* a) {
+    return builtin_guard(e, a, builtin_when);
+}
+
+lval* builtin_unless(lenv* e, lval* a) {
+    return builtin_guard(e, a, builtin_unless);
+}
+
+lval* fixed_not(lenv* e, lval** a) {
+    if (a[0]->type != LVAL_NUM) {
+        return NULL;
+    }
+    return lval_num(a[0]->num > 0 ? 0 : 1);
+}
+
 lval* builtin_not(lenv* e, lval* a) {
     LASSERT_SIZE(a, 1, "Not only accepts one argument");
     LASSERT_ARG_TYPE(a, 0, LVAL_NUM,
                      "First argument to not must be a %s not a %s",
                      ltype_name(LVAL_NUM), ltype_name(a->cell[0]->type));
 
-    lval* v = NULL;
-    if (a->cell[0]->num > 0) {
-        v = lval_num(0);
-    }
-    else {
-        v = lval_num(1);
-    }
+    lval* v = fixed_not(e, a->cell);
     lval_delete(a);
     return v;
 }
@@ -799,13 +1987,19 @@ lval* builtin_load(lenv* e, lval* a) {
     mpc_result_t r;
     if (mpc_parse_contents(a->cell[0]->str, Lispy, &r)) {
         lval* expr = lval_read(r.output);
+        mpc_ast_delete(r.output);
+        lgc_push_root(a);
+        lgc_push_root(expr);
         while(expr->count) {
             lval* x = lval_eval(e, lval_pop(expr, 0));
             if (x->type == LVAL_ERR) {
                 lval_println(e, x);
             }
             lval_delete(x);
+            lgc_safepoint();
         }
+        lgc_pop_root();
+        lgc_pop_root();
 
         lval_delete(expr);
         lval_delete(a);
@@ -833,6 +2027,22 @@ lval* builtin_print(lenv* e, lval* a) {
     return lval_sexpr();
 }
 
+// A lone symbol in an S-expression evaluates to its value rather than a call,
+// so this is invoked as (alloc-stats ()) and its arguments are ignored.
+lval* builtin_alloc_stats(lenv* e, lval* a) {
+    lpool_print_stats();
+    lgc_print_stats();
+    lval_delete(a);
+    return lval_sexpr();
+}
+
+// Invoked as (env-stats ()) like alloc-stats.
+lval* builtin_env_stats(lenv* e, lval* a) {
+    lenv_print_stats();
+    lval_delete(a);
+    return lval_sexpr();
+}
+
 lval* builtin_error(lenv* e, lval* a) {
     LASSERT_SIZE(a, 1, "Error function requires exactly one argument");
     LASSERT_ARG_TYPE(a, 0, LVAL_STR, "Error function requires a %s not a %s",
@@ -1,4 +1,5 @@
 #pragma once
+#include "../config.h"
 #include "mpc.h"
 #include "lenv.h"
 #define LASSERT(args, cond, fmt, ...)                   \
@@ -9,52 +10,137 @@
     }
 #define LASSERT_SIZE(args, size, fmt, ...) \
     if (args->count != size) { \
+        lval* err = lval_err(fmt, ##__VA_ARGS__); \
         lval_delete(args); \
-        return lval_err(fmt, ##__VA_ARGS__); \
+        return err; \
     }
 #define LASSERT_NONEMPTY(args, fmt, ...) \
     if (args->cell[0]->count == 0){                           \
+        lval* err = lval_err(fmt, ##__VA_ARGS__);             \
         lval_delete(args);                                    \
-        return lval_err(fmt, ##__VA_ARGS__);                  \
+        return err;                                           \
     }
 #define LASSERT_ARG_TYPE(args, pos, expected_type, fmt, ...)      \
     if (args->cell[pos]->type != expected_type) {                 \
+        lval* err = lval_err(fmt, ##__VA_ARGS__);                 \
         lval_delete(args);                                        \
-        return lval_err(fmt, ##__VA_ARGS__);                      \
+        return err;                                               \
     }
 
+// Smallest non-empty cell array; lists grow by doubling from here
+#define LVAL_MIN_CAP 4
+
+// Default limit on how deeply evaluation may nest, counting S-expressions
+// being evaluated and calls in progress (see lval_set_max_depth). Also the
+// fixed limit on how deeply a lambda's body may nest (see lval_resolve).
+#define LVAL_MAX_DEPTH 10000
+
+// Numbers in this range are shared, immortal cells (see lval_num)
+#define LVAL_SMALL_NUM_MIN -256
+#define LVAL_SMALL_NUM_MAX 1024
+
 enum { LVAL_NUM, LVAL_ERR, LVAL_SYM, LVAL_STR, LVAL_FUN, LVAL_SEXPR,
-       LVAL_QEXPR };
+       LVAL_QEXPR, LVAL_CONS };
 
-mpc_parser_t* Number;
-mpc_parser_t* Symbol;
-mpc_parser_t* Sexpr;
-mpc_parser_t* Qexpr;
-mpc_parser_t* Expr;
-mpc_parser_t* Lispy;
-mpc_parser_t* String;
-mpc_parser_t* Comment;
+// The reader's grammar, built by lval_grammar_init
+extern mpc_parser_t* Number;
+extern mpc_parser_t* Symbol;
+extern mpc_parser_t* Sexpr;
+extern mpc_parser_t* Qexpr;
+extern mpc_parser_t* Expr;
+extern mpc_parser_t* Lispy;
+extern mpc_parser_t* String;
+extern mpc_parser_t* Comment;
 
-typedef lval*(*lbuiltin)(lenv*, lval*);
+/* Storage for list cells. A buffer owns one reference to each value in
+ * items[lo..hi). Lists are views of a window of a buffer, and any number of
+ * lists may share one, so copying a list, tail, init and popping either end
+ * are O(1). A list only writes to a buffer it is the sole owner of.
+ */
+typedef struct lcells {
+    int refs;
+    int cap;
+    int lo;
+    int hi;
+    struct lval* items[];
+} lcells;
 
 // Forward declared in lenv.h
 struct lval {
     int type;
-    long num;
+    // Values are shared by reference count. lval_copy takes a reference and
+    // lval_delete drops one; lval_unshare before mutating anything you hold.
+    int refs;
+
+    // Only the payload for the current type is live, so every node is the
+    // size of its largest variant rather than the sum of all of them.
+    union {
+        long num;
 
-    // Error and Symbol types have string data
-    char* err;
-    char* sym;
-    char* str;
+        // Error, Symbol and String types have string data. Symbol names
+        // are interned (see lsym.h) and never freed with the lval.
+        char* err;
+        char* str;
 
-    lbuiltin builtin;
-    lenv* env;
-    lval* formals;
-    lval* body;
+        // Symbol. slot is the frame slot the symbol was resolved to when
+        // the enclosing lambda was created, or -1 (see lval_resolve).
+        struct {
+            char* sym;
+            int slot;
+            // Inline cache of where this reference was last found, valid
+            // while ic_version is current (see lenv_get_cached)
+            int ic_slot;
+            lenv* ic_env;
+            unsigned long ic_version;
+        };
 
-    // List of lvals
-    struct lval** cell;
-    int count;
+        // Function. builtin is NULL for lambdas. arity is the number of
+        // formals before any '&', and variadic is set when they end in
+        // '& rest'; arity is -1 when the formals need binding one by one
+        // (see lval_fun_shape). body is kept as written; code is compiled
+        // from a copy with constants inlined (see lcode.h), and a lambda
+        // without it has its body interpreted. special marks a builtin
+        // that is passed its operands unevaluated (see lenv_add_special).
+        // A builtin with a fixed fast path takes it for calls with
+        // exactly arity arguments; otherwise its arity is -1.
+        struct {
+            lbuiltin builtin;
+            union {
+                lenv* env;
+                lfixed fixed;
+            };
+            struct lval* formals;
+            struct lval* body;
+            struct lcode* code;
+            int arity;
+            unsigned char variadic;
+            unsigned char special;
+        };
+
+        // S-Expression and Q-Expression: the count lvals starting at cell,
+        // which points into buf. buf is NULL when the list is empty.
+        struct {
+            struct lval** cell;
+            int count;
+            lcells* buf;
+        };
+
+        // Cons-List: an immutable cell holding the first value and the rest
+        // of the list, so cons and tail share structure. len is the length
+        // of the list starting here. The empty list is lval_nil().
+        struct {
+            struct lval* car;
+            struct lval* cdr;
+            long len;
+        };
+    };
+
+#ifdef LISPY_GC
+    // Tracing collector bookkeeping, see lgc.c
+    struct lval* gc_prev;
+    struct lval* gc_next;
+    int gc_mark;
+#endif
 };
 
 lval* lval_num (long x);
@@ -65,18 +151,31 @@ lval* lval_qexpr(void);
 lval* lval_fun(lbuiltin func);
 lval* lval_lambda(lval* formals, lval* body);
 lval* lval_str(char* s);
+lval* lval_nil(void);
+lval* lval_cons(lval* car, lval* cdr);
 
+void lval_grammar_init(void);
+void lval_grammar_cleanup(void);
 lval* lval_read(mpc_ast_t* t);
 void lval_println(lenv* e, lval* v);
 void lval_print(lenv* e, lval* v);
 void lval_delete(lval* v);
 lval* lval_copy(lval* v);
+lval* lval_unshare(lval* v);
+int lval_is_immortal(lval* v);
 
 lval* lval_eval(lenv *e, lval* v);
+int lval_set_max_depth(int n);
 lval* lval_call(lenv* e, lval* f, lval* a);
+lenv* lval_push_frame(lenv* par, lval* f, lval** args, int extra);
+lenv* lval_bind_frame(lenv* par, lval* f, lval* a, int extra);
+lval* lval_call_args(lenv* e, lval* f, lval** args);
+lval* lval_cond_err(lbuiltin form, int i, int type);
 lval* lval_take(lval* v, int i);
 lval* lval_pop(lval* v, int i);
 lval* lval_add(lval* v, lval* x);
+lval* lval_reserve(lval* v, int n);
+void lcells_release(lcells* b);
 
 lval* builtin_list(lenv* e, lval* a);
 lval* builtin_head(lenv* e, lval* a);
@@ -93,6 +192,8 @@ lval* builtin_div(lenv* e, lval* a);
 lval* builtin_modulo(lenv* e, lval* a);
 lval* builtin_lambda(lenv* e, lval* a);
 lval* builtin_def(lenv* e, lval* a);
+lval* builtin_defconst(lenv* e, lval* a);
+lval* builtin_sandbox(lenv* e, lval* a);
 lval* builtin_put(lenv* e, lval* a);
 lval* builtin_fun(lenv* e, lval* a);
 lval* builtin_gt(lenv* e, lval* a);
@@ -104,9 +205,28 @@ lval* builtin_ne(lenv* e, lval* a);
 lval* builtin_if(lenv* e, lval* a);
 lval* builtin_or(lenv* e, lval* a);
 lval* builtin_and(lenv* e, lval* a);
+lval* builtin_cond(lenv* e, lval* a);
+lval* builtin_when(lenv* e, lval* a);
+lval* builtin_unless(lenv* e, lval* a);
 lval* builtin_not(lenv* e, lval* a);
 lval* builtin_load(lenv* e, lval* a);
 lval* builtin_print(lenv* e, lval* a);
 lval* builtin_error(lenv* e, lval* a);
+lval* builtin_alloc_stats(lenv* e, lval* a);
+lval* builtin_env_stats(lenv* e, lval* a);
+lval* builtin_clist(lenv* e, lval* a);
+
+/* Fast paths of the hottest builtins. Arguments are borrowed, and NULL
+ * means the call should go to the builtin itself, which reports what is
+ * wrong with them.
+ */
+lval* fixed_add(lenv* e, lval** a);
+lval* fixed_sub(lenv* e, lval** a);
+lval* fixed_lt(lenv* e, lval** a);
+lval* fixed_eq(lenv* e, lval** a);
+lval* fixed_head(lenv* e, lval** a);
+lval* fixed_tail(lenv* e, lval** a);
+lval* fixed_len(lenv* e, lval** a);
+lval* fixed_not(lenv* e, lval** a);
 
 char* ltype_name(int t);
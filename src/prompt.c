@@ -1,8 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "mpc.h"
 #include "lval.h"
+#include "lcode.h"
+#include "lframe.h"
+#include "lgc.h"
+#include "lmod.h"
+#include "lpool.h"
+#include "lsym.h"
 #include "../config.h"
 
 #if defined(_WIN64) || defined(_WIN32) || HAVE_LIBEDIT == 0
@@ -29,33 +36,31 @@ void add_history (char* _unused) {};
 #endif
 
 int main (int argc, char** argv) {
-    Number = mpc_new("number");
-    Symbol = mpc_new("symbol");
-    Sexpr  = mpc_new("sexpr");
-    Qexpr  = mpc_new("qexpr");
-    Expr   = mpc_new("expr");
-    Lispy  = mpc_new("lispy");
-    String = mpc_new("string");
-    Comment = mpc_new("comment");
-
-    mpca_lang(MPC_LANG_DEFAULT,
-  "                                                   \
-    number : /-?[0-9]+/ ;                             \
-    symbol : /[a-zA-Z0-9_+\\-*\\/\\\\=<>!&]+/ ;       \
-    sexpr  : '(' <expr>* ')' ;                        \
-    qexpr  : '{' <expr>* '}' ;                        \
-    expr   : <number> | <symbol> | <sexpr> | <qexpr> | <string> | <comment>;\
-    string : /\"(\\\\.|[^\"])*\"/ ;                  \
-    comment: /;[^\\r\\n]*/ ;                         \
-    lispy  : /^/ <expr>* /$/ ;               \
-  ",
-              Number, Symbol, Sexpr, Expr, Qexpr, Lispy, String, Comment);
+    lval_grammar_init();
     puts("Lispy Version 0.0.0.0.1");
     puts("Press Ctrl+C to exit\n");
 
+    // --env-stats reports environment counters on exit and --max-depth=N
+    // limits how deeply evaluation may nest; other arguments are files to
+    // load
+    int env_stats = 0;
+    int files = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--env-stats") == 0) {
+            env_stats = 1;
+        }
+        else if (strncmp(argv[i], "--max-depth=", 12) == 0) {
+            lval_set_max_depth(atoi(argv[i] + 12));
+        }
+        else {
+            files++;
+        }
+    }
+
     lenv* e = lenv_new();
     lenv_add_builtins(e);
-    if (argc == 1) {
+    lgc_add_root_env(e);
+    if (files == 0) {
         while (1) {
             char* input = readline("lispy> ");
             if (input == NULL) {
@@ -76,10 +81,14 @@ int main (int argc, char** argv) {
             }
 
             free(input);
+            lgc_safepoint();
         }
     }
     else {
         for (int i = 1; i < argc; i++) {
+            if (strncmp(argv[i], "--", 2) == 0) {
+                continue;
+            }
             lval* args = lval_add(lval_sexpr(), lval_str(argv[i]));
             lval* x = builtin_load(e, args);
             if (x->type == LVAL_ERR) { lval_println(e, x); }
@@ -87,6 +96,15 @@ int main (int argc, char** argv) {
         }
     }
 
-    mpc_cleanup(8, Number, Symbol, Sexpr, Qexpr, Expr, Lispy, String, Comment);
+    if (env_stats) {
+        lenv_print_stats();
+    }
+
+    lval_grammar_cleanup();
     lenv_delete(e);
+    lmod_destroy();
+    lframe_destroy();
+    lcode_destroy();
+    lpool_destroy();
+    lsym_destroy();
 }
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/lcode.h"
+#include "../src/lenv.h"
+#include "../src/lval.h"
+
+/* Time recursive functions run as bytecode against the same functions
+ * with their code dropped, so the body is interpreted on every call.
+ *
+ *   make -C tests bench_lcode && tests/bench_lcode
+ */
+
+static char* program =
+    "(fun {fib n} {if (< n 2) {n} {+ (fib (- n 1)) (fib (- n 2))}})"
+    "(fun {range n} {if (== n 0) {{}} {join (range (- n 1)) (list n)}})"
+    "(fun {foldl f z xs}"
+    "  {if (== xs {}) {z} {foldl f (f z (eval (head xs))) (tail xs)}})"
+    "(fun {add x y} {+ x y})"
+    "(fun {classify n} {cond {(< n 10) 0} {(and (> n 50) (< n 100)) 2} {1 1}})"
+    "(fun {classes xs acc} {if (== xs {}) {acc}"
+    "  {classes (tail xs) (+ acc (classify (eval (head xs))))}})"
+    "(def {xs} (range 400))";
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Evaluate each expression in src, returning the value of the last
+static lval* run(lenv* e, char* src) {
+    mpc_result_t r;
+    if (!mpc_parse("<bench>", src, Lispy, &r)) {
+        mpc_err_print(r.error);
+        mpc_err_delete(r.error);
+        exit(1);
+    }
+    lval* exprs = lval_read(r.output);
+    mpc_ast_delete(r.output);
+
+    lval* x = lval_sexpr();
+    while (exprs->count) {
+        lval_delete(x);
+        x = lval_eval(e, lval_pop(exprs, 0));
+    }
+    lval_delete(exprs);
+    return x;
+}
+
+static void drop_code(lenv* e, char* name) {
+    lval* k = lval_sym(name);
+    lval* f = lenv_get(e, k);
+    lval_delete(lcode_release(f->code));
+    f->code = NULL;
+    lval_delete(f);
+    lval_delete(k);
+}
+
+static double time_run(lenv* e, char* src, int reps, long* checksum) {
+    double start = now();
+    for (int i = 0; i < reps; i++) {
+        lval* x = run(e, src);
+        *checksum += x->num;
+        lval_delete(x);
+    }
+    return (now() - start) / reps;
+}
+
+int main(void) {
+    lval_grammar_init();
+
+    char* cases[][2] = {
+        { "fib 22", "(fib 22)" },
+        { "foldl 400", "(foldl add 0 xs)" },
+        { "cond 400", "(classes xs 0)" },
+    };
+    int ncases = sizeof(cases) / sizeof(cases[0]);
+    double compiled[ncases];
+    double interpreted[ncases];
+    long checksum = 0;
+
+    for (int mode = 0; mode < 2; mode++) {
+        lenv* e = lenv_new();
+        lenv_add_builtins(e);
+        lval_delete(run(e, program));
+        if (mode == 1) {
+            drop_code(e, "fib");
+            drop_code(e, "foldl");
+            drop_code(e, "add");
+            drop_code(e, "classify");
+            drop_code(e, "classes");
+        }
+        for (int i = 0; i < ncases; i++) {
+            double t = time_run(e, cases[i][1], 20, &checksum);
+            (mode == 0 ? compiled : interpreted)[i] = t;
+        }
+        lenv_delete(e);
+    }
+
+    for (int i = 0; i < ncases; i++) {
+        printf("%-10s %8.3f ms interpreted %8.3f ms compiled %5.2fx\n",
+               cases[i][0], interpreted[i] * 1e3, compiled[i] * 1e3,
+               interpreted[i] / compiled[i]);
+    }
+    printf("checksum %ld\n", checksum);
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "../src/lenv.h"
+#include "../src/lval.h"
+
+/* Time global lookups as the environment grows. The hash index keeps the
+ * number of probes per lookup constant, but keys are drawn at random, so
+ * once the symbols and tables outgrow the CPU caches every lookup pays for
+ * the misses. Expect tens of ns up to a few thousand bindings, rising to
+ * a few hundred at 65536; a linear scan would grow with n from the start.
+ *
+ *   make -C tests bench_lenv && tests/bench_lenv
+ */
+
+#define LOOKUPS 1000000
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+    for (int n = 16; n <= 65536; n *= 4) {
+        lenv* e = lenv_new();
+        lval** keys = malloc(sizeof(lval*) * n);
+        char name[32];
+        for (int i = 0; i < n; i++) {
+            snprintf(name, sizeof(name), "g%d", i);
+            keys[i] = lval_sym(name);
+            lval* v = lval_num(i);
+            lenv_put(e, keys[i], v);
+            lval_delete(v);
+        }
+
+        long sum = 0;
+        unsigned long r = 1;
+        double start = now();
+        for (int i = 0; i < LOOKUPS; i++) {
+            r = r * 6364136223846793005UL + 1442695040888963407UL;
+            lval* v = lenv_get(e, keys[(r >> 33) % n]);
+            sum += v->num;
+            lval_delete(v);
+        }
+        double elapsed = now() - start;
+
+        printf("%6d bindings: %6.1f ns/lookup (checksum %ld)\n",
+               n, elapsed * 1e9 / LOOKUPS, sum);
+
+        for (int i = 0; i < n; i++) {
+            lval_delete(keys[i]);
+        }
+        free(keys);
+        lenv_delete(e);
+    }
+    return 0;
+}
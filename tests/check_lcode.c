@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/lcode.h"
+#include "../src/lframe.h"
+#include "../src/lenv.h"
+#include "../src/lval.h"
+#include "minunit/minunit.h"
+
+// Evaluate each expression in src, returning the value of the last
+static lval* run(lenv* e, char* src) {
+    mpc_result_t r;
+    mpc_parse("<test>", src, Lispy, &r);
+    lval* exprs = lval_read(r.output);
+    mpc_ast_delete(r.output);
+
+    lval* x = lval_sexpr();
+    while (exprs->count) {
+        lval_delete(x);
+        x = lval_eval(e, lval_pop(exprs, 0));
+    }
+    lval_delete(exprs);
+    return x;
+}
+
+static long run_num(lenv* e, char* src) {
+    lval* x = run(e, src);
+    long n = x->type == LVAL_NUM ? x->num : -1;
+    lval_delete(x);
+    return n;
+}
+
+/* Define f, then evaluate src with f either compiled or with its code
+ * dropped so that its body is interpreted.
+ */
+static lval* run_f(char* def, char* src, int compiled) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval_delete(run(e, def));
+    if (!compiled) {
+        lval* k = lval_sym("f");
+        lval* f = lenv_get(e, k);
+        lval_delete(lcode_release(f->code));
+        f->code = NULL;
+        lval_delete(f);
+        lval_delete(k);
+    }
+    lval* x = run(e, src);
+    lenv_delete(e);
+    return x;
+}
+
+static int same_result(char* def, char* src, int type) {
+    lval* compiled = run_f(def, src, 1);
+    lval* interpreted = run_f(def, src, 0);
+    int same = compiled->type == type && lval_eq(compiled, interpreted);
+    lval_delete(compiled);
+    lval_delete(interpreted);
+    return same;
+}
+
+MU_TEST(test_lcode_matches_interpreter) {
+    lval_grammar_init();
+    mu_assert(same_result("(fun {f n} {if (< n 2) {n} "
+                          "{+ (f (- n 1)) (f (- n 2))}})",
+                          "(f 15)", LVAL_NUM),
+              "Recursion through if should match the interpreter");
+    mu_assert(same_result("(fun {f x} {if x {if (- x 1) {1} {2}} {3}})",
+                          "(list (f 0) (f 1) (f 2))", LVAL_QEXPR),
+              "Nested ifs should match the interpreter");
+    mu_assert(same_result("(fun {f & xs} {len xs})",
+                          "(list (f) (f 1 2 3))", LVAL_QEXPR),
+              "Variadic bodies should match the interpreter");
+    mu_assert(same_result("(fun {f x} {x})", "(f {1 2})", LVAL_QEXPR),
+              "A single value body should be that value");
+    mu_assert(same_result("(fun {f x} {})", "(f 1)", LVAL_SEXPR),
+              "An empty body should be an empty S-expression");
+    mu_assert(same_result("(fun {f x} {() x})", "(f 1)", LVAL_STR),
+              "A body starting with () should match the interpreter");
+    mu_assert(same_result("(fun {f x} {1 x})", "(f 1)", LVAL_ERR),
+              "A body not starting with a function should be an error");
+}
+
+MU_TEST(test_lcode_if_fallback) {
+    lval_grammar_init();
+    mu_assert(same_result("(fun {f x} {if {1} {1} {2}})", "(f 0)", LVAL_ERR),
+              "A condition that isn't a number should be reported by if");
+    mu_assert(same_result("(fun {f if} {if 1 {2} {3}})", "(f list)",
+                          LVAL_QEXPR),
+              "A formal named if should be called, not compiled as if");
+}
+
+MU_TEST(test_lcode_error_stops_body) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* x = run(e, "(fun {f x} {+ (undefined-sym) (def {touched} 1)})"
+                  "(f 0)");
+    mu_assert(x->type == LVAL_ERR,
+              "An unbound symbol should be the body's value");
+    lval_delete(x);
+
+    x = run(e, "touched");
+    mu_assert(x->type == LVAL_ERR,
+              "Nothing after an error should be evaluated");
+    lval_delete(x);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lcode_shared_between_copies) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* f = run(e, "(fun {f x y} {+ x y})");
+    lval* g = run(e, "(f 1)");
+
+    mu_assert(g->type == LVAL_FUN && g->code == f->code,
+              "Partial application should share the compiled body");
+    mu_assert(f->code->refs == 2,
+              "Sharing code should take a reference to it");
+
+    lval_delete(g);
+    mu_assert(f->code->refs == 1,
+              "Deleting a copy should release its code");
+    lval_delete(f);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lcode_special_forms) {
+    lval_grammar_init();
+    mu_assert(same_result("(fun {f x} {list (and x (undefined-sym)) "
+                          "(or (- 1 x) (undefined-sym))})",
+                          "(f 0)", LVAL_QEXPR),
+              "and and or should match the interpreter");
+    mu_assert(same_result("(fun {f x} {cond {(== x 0) \"zero\"} "
+                          "{(< x 0) list \"neg\"} {1 \"pos\"}})",
+                          "(list (f 0) (f -1) (f 1))", LVAL_QEXPR),
+              "cond should match the interpreter");
+    mu_assert(same_result("(fun {f x} {list (when x {+ x 1}) "
+                          "(unless x (- x 1)) (if x (* x 2) x)})",
+                          "(list (f 0) (f 3))", LVAL_QEXPR),
+              "when, unless and unwrapped branches should match the "
+              "interpreter");
+    mu_assert(same_result("(fun {f x} {if (and x 1) {x} {0}})",
+                          "(list (f 0) (f 2))", LVAL_QEXPR),
+              "A special form as the condition of if should match the "
+              "interpreter");
+}
+
+MU_TEST(test_lcode_call_depth_limit) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    int old = lval_set_max_depth(200);
+    lval* x = run(e, "(fun {f n} {+ 1 (f n)}) (f 0)");
+    mu_assert(x->type == LVAL_ERR,
+              "Calls bound straight from the stack should still be limited");
+    mu_assert(lframe_depth() == 0,
+              "Every frame should be popped after the limit is hit");
+    lval_delete(x);
+    lval_set_max_depth(old);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lcode_branches_passed_as_values) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    mu_assert(run_num(e, "(def {yes} {+ 1 2}) (if 1 yes no)") == 3,
+              "A Q-Expression a branch evaluates to should be run");
+    mu_assert(run_num(e, "(when 1 yes)") == 3,
+              "when should run a Q-Expression a branch evaluates to");
+    lenv_delete(e);
+
+    char* pick = "(fun {f c a b} {if c a b})";
+    char* src = "(list (f 0 {+ 1 2} {+ 10 20}) (f 1 {+ 1 2} {+ 10 20}))";
+    for (int compiled = 0; compiled < 2; compiled++) {
+        lval* x = run_f(pick, src, compiled);
+        mu_assert(x->type == LVAL_QEXPR && x->count == 2 &&
+                  x->cell[0]->num == 30 && x->cell[1]->num == 3,
+                  "Branches passed as arguments should be run");
+        lval_delete(x);
+    }
+    mu_assert(same_result("(fun {f x} {list (if x (list 1 2) {3}) "
+                          "(unless x (head {{4}}))})",
+                          "(list (f 0) (f 1))", LVAL_ERR),
+              "A branch whose value can't be run should match the "
+              "interpreter");
+}
+
+MU_TEST(test_lcode_special_forms_short_circuit) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* x = run(e, "(fun {f x} {or x (def {touched} 1)}) (f 1)");
+    mu_assert(x->type == LVAL_NUM && x->num == 1,
+              "or should return as soon as an operand is true");
+    lval_delete(x);
+
+    x = run(e, "touched");
+    mu_assert(x->type == LVAL_ERR,
+              "Operands after a true one should not be evaluated");
+    lval_delete(x);
+
+    x = run(e, "(fun {g x} {and x (def {touched} 1)}) (g 1) touched");
+    mu_assert(x->type == LVAL_NUM && x->num == 1,
+              "Operands up to a false one should be evaluated");
+    lval_delete(x);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lcode_fixed_builtins) {
+    lval_grammar_init();
+    mu_assert(same_result("(fun {f x} {list (+ x 1) (- x 1) (< x 1) "
+                          "(== x {1}) (head {1 2}) (tail {1 2}) (len {1 2}) "
+                          "(not x) (+ x 1 2) (- x)})",
+                          "(f 4)", LVAL_QEXPR),
+              "Builtins with a fast path should match the interpreter");
+
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* x = run(e, "(fun {f x} {+ x {}}) (f 1)");
+    mu_assert(x->type == LVAL_ERR && strcmp(x->err, "Cannot do operator on "
+                                            "a non-number: Q-Expression") == 0,
+              "Arguments the fast path declines should be reported by the "
+              "builtin");
+    lval_delete(x);
+    lenv_delete(e);
+}
+
+// Deep enough to overflow the C stack if each iteration nested a call
+#define LOOP_ITERATIONS "200000"
+
+MU_TEST(test_lcode_tail_calls) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    run_num(e, "(fun {loop n acc} {if (== n 0) {acc} "
+            "{loop (- n 1) (+ acc 1)}})");
+    mu_assert(run_num(e, "(loop " LOOP_ITERATIONS " 0)") == 200000,
+              "A self tail call should run in constant stack");
+    mu_assert(lframe_depth() == 0,
+              "Tail calls should pop every frame they push");
+
+    run_num(e, "(fun {even n} {if (== n 0) {1} {odd (- n 1)}})"
+            "(fun {odd n} {if (== n 0) {0} {even (- n 1)}})");
+    mu_assert(run_num(e, "(even " LOOP_ITERATIONS ")") == 1,
+              "Mutual tail calls should run in constant stack");
+
+    run_num(e, "(fun {spin n} {if (== n 0) {0} {eval {spin (- n 1)}}})");
+    mu_assert(run_num(e, "(spin " LOOP_ITERATIONS ")") == 0,
+              "A tail call through eval should run in constant stack");
+    lenv_delete(e);
+}
+
+static lval* frame_depth(lenv* e, lval* a) {
+    lval_delete(a);
+    return lval_num(lframe_depth());
+}
+
+MU_TEST(test_lcode_mutual_tail_calls_bound_frames) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* k = lval_sym("depth");
+    lval* f = lval_fun(frame_depth);
+    lenv_put(e, k, f);
+    lval_delete(f);
+    lval_delete(k);
+
+    // Neither frame binds the other's formal, so each is carried over
+    run_num(e, "(fun {ev n} {if (== n 0) {depth 0} {od (- n 1)}})"
+            "(fun {od m} {if (== m 0) {depth 0} {ev (- m 1)}})");
+    long depth = run_num(e, "(ev " LOOP_ITERATIONS ")");
+    mu_assert(depth >= 1 && depth <= 2,
+              "Mutual tail calls with different formals should not keep "
+              "every caller's frame");
+    mu_assert(lframe_depth() == 0,
+              "Tail calls should pop every frame they push");
+    lenv_delete(e);
+}
+
+MU_TEST(test_lcode_tail_call_keeps_dynamic_scope) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    // g's frame doesn't bind x, so f's frame must stay visible under it
+    run_num(e, "(fun {g y} {+ x y}) (fun {f x} {g 1})");
+    mu_assert(run_num(e, "(f 41)") == 42,
+              "A tail call should still see its caller's bindings");
+    mu_assert(lframe_depth() == 0,
+              "A kept caller frame should be popped on return");
+    lenv_delete(e);
+}
+
+MU_TEST(test_lcode_constants_are_lexical) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    // f binds c, so g and h called from it find f's c if they look it up
+    run_num(e, "(fun {f c} {list (g 0) (h 0)}) (fun {h _} {c})"
+            "(defconst {c} 5) (fun {g _} {c})");
+    lval* x = run(e, "(f 9)");
+    mu_assert(x->type == LVAL_QEXPR && x->count == 2 &&
+              x->cell[0]->num == 5 && x->cell[1]->num == 9,
+              "A constant should be fixed where a lambda is defined, not "
+              "where it is called");
+    lval_delete(x);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lcode_sandbox_hides_callers_frames) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    // The first call of L caches where secret is, in h's live frame
+    lval_delete(run(e, "(fun {L d} {secret})"
+                    "(fun {h secret} {list (L 0) (sandbox {L 0})})"));
+    lval* x = run(e, "(h 42)");
+    mu_assert(x->type == LVAL_ERR,
+              "A sandbox should not see its caller's frames through a cache");
+    lval_delete(x);
+    lenv_delete(e);
+}
+
+// (+ 1 (+ 1 ... (+ 1 0))) nested depth times
+static lval* nested_sum(int depth) {
+    lval* v = lval_num(0);
+    for (int i = 0; i < depth; i++) {
+        v = lval_add(lval_add(lval_add(lval_sexpr(), lval_sym("+")),
+                              lval_num(1)), v);
+    }
+    return v;
+}
+
+MU_TEST(test_lcode_deep_body_not_compiled) {
+    lval* body = nested_sum(LVAL_MAX_DEPTH + 1);
+    mu_assert(lcode_compile(body) == NULL,
+              "A body nested past the limit should be left uncompiled");
+
+    lcode* c = lcode_compile(nested_sum(LVAL_MAX_DEPTH));
+    mu_assert(c != NULL, "A body within the limit should be compiled");
+    lval_delete(lcode_release(c));
+}
+
+MU_TEST(test_lcode_body_matches_interpreter) {
+    lval_grammar_init();
+    char* cases[][2] = {
+        { "(fun {f x} {if (< x 1) {x} {+ x 1}})", "(list (f 0) (f 5))" },
+        { "(fun {f x} {if x (* x 2) 0})", "(list (f 0) (f 3))" },
+        { "(fun {f x} {list (and x (> x 1)) (or (== x 0) (> x 2))})",
+          "(list (f 0) (f 2) (f 3))" },
+        { "(fun {f x} {list (when x 1 {+ x 2}) (unless x {1} 2)})",
+          "(list (f 0) (f 1))" },
+        { "(fun {f x} {cond {(< x 0) - 0 x} {(== x 0) \"zero\"} "
+          "{1 list x x}})", "(list (f -2) (f 0) (f 2))" },
+        { "(fun {f x} {cond {x} {1 0}})", "(list (f 0) (f 7))" },
+        { "(fun {f n} {cond {(== n 0) 0} {1 when 1 (f (- n 1))}})",
+          "(f 1000)" },
+        { "(fun {f and} {and 1 2})", "(f list)" },
+        { "(def {g} if) (fun {f x} {g x {1} (undefined-sym)})", "(f 1)" },
+        { "(fun {f x} {and 1 x})", "(f {})" },
+        { "(fun {f x} {cond {0 1} {x 1}})", "(f \"s\")" },
+        { "(fun {f x} {when x 1})", "(f {})" },
+        { "(fun {f x} {if x 1 2})", "(f (undefined-sym))" },
+    };
+
+    for (int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); i++) {
+        lval* compiled = run_f(cases[i][0], cases[i][1], 1);
+        lval* interpreted = run_f(cases[i][0], cases[i][1], 0);
+        int same = lval_eq(compiled, interpreted);
+        lval_delete(compiled);
+        lval_delete(interpreted);
+        char msg[256];
+        snprintf(msg, sizeof(msg), "A compiled body should evaluate as the "
+                 "interpreted one does: %s %s", cases[i][0], cases[i][1]);
+        mu_assert(same, msg);
+    }
+}
+
+MU_TEST(test_lcode_body_left_intact) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* f = run(e, "(fun {f x} {cond {(< x 0) - 0 x} "
+                  "{1 when (> x 1) (+ x 1)}})");
+    lval* clause = f->body->cell[2];
+    int refs = clause->refs;
+    lval* before = lval_copy(f->body);
+
+    for (int i = 0; i < 10; i++) {
+        lval_delete(run(e, "(list (f -3) (f 0) (f 5))"));
+    }
+    mu_assert(f->code != NULL, "A lambda's body should be compiled");
+    mu_assert(f->body->cell[2] == clause && clause->refs == refs,
+              "Calls should hold no references to the body once done");
+    mu_assert(f->body == before && lval_eq(f->body, before),
+              "Calls should leave the body as it was");
+
+    lval_delete(before);
+    lval_delete(f);
+    lenv_delete(e);
+}
+
+MU_TEST_SUITE(lcode_suite) {
+    MU_RUN_TEST(test_lcode_matches_interpreter);
+    MU_RUN_TEST(test_lcode_if_fallback);
+    MU_RUN_TEST(test_lcode_error_stops_body);
+    MU_RUN_TEST(test_lcode_shared_between_copies);
+    MU_RUN_TEST(test_lcode_special_forms);
+    MU_RUN_TEST(test_lcode_branches_passed_as_values);
+    MU_RUN_TEST(test_lcode_special_forms_short_circuit);
+    MU_RUN_TEST(test_lcode_fixed_builtins);
+    MU_RUN_TEST(test_lcode_call_depth_limit);
+    MU_RUN_TEST(test_lcode_tail_calls);
+    MU_RUN_TEST(test_lcode_mutual_tail_calls_bound_frames);
+    MU_RUN_TEST(test_lcode_tail_call_keeps_dynamic_scope);
+    MU_RUN_TEST(test_lcode_constants_are_lexical);
+    MU_RUN_TEST(test_lcode_body_matches_interpreter);
+    MU_RUN_TEST(test_lcode_deep_body_not_compiled);
+    MU_RUN_TEST(test_lcode_body_left_intact);
+    MU_RUN_TEST(test_lcode_sandbox_hides_callers_frames);
+}
+
+int main() {
+    MU_RUN_SUITE(lcode_suite);
+    MU_REPORT();
+    MU_RETURN_VALUE();
+}
@@ -58,10 +58,196 @@ MU_TEST(test_lenv_lookup_sym_success) {
     lenv_delete(e);
 }
 
+MU_TEST(test_lenv_many_bindings) {
+    lenv* e = lenv_new();
+    char name[32];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "g%d", i);
+        lval* k = lval_sym(name);
+        lval* v = lval_num(i);
+        lenv_put(e, k, v);
+        lval_delete(k);
+        lval_delete(v);
+    }
+
+    mu_assert(e->index != NULL,
+              "A large environment should be indexed");
+    for (int i = 0; i < 1000; i++) {
+        snprintf(name, sizeof(name), "g%d", i);
+        lval* k = lval_sym(name);
+        lval* result = lenv_get(e, k);
+        mu_assert(result->type == LVAL_NUM && result->num == i,
+                  "Every binding should be found in a large environment");
+        lval_delete(result);
+        lval_delete(k);
+    }
+
+    lval* k = lval_sym("g500");
+    lval* v = lval_num(-1);
+    lenv_put(e, k, v);
+    mu_assert(e->count == 1000,
+              "Rebinding a symbol should not add a new binding");
+
+    lenv* c = lenv_copy(e);
+    lval* result = lenv_get(c, k);
+    mu_assert(result->num == -1,
+              "A copied environment should see the rebound value");
+    lval_delete(result);
+
+    lval_delete(v);
+    lval_delete(k);
+    lenv_delete(c);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lenv_get_cached_hit) {
+    lenv* e = lenv_new();
+    lval* k = lval_sym("cached");
+    lval* v = lval_num(7);
+    lenv_put(e, k, v);
+
+    lval* result = lenv_get_cached(e, k);
+    mu_assert(result->num == 7 && k->ic_env == e,
+              "A lookup should fill the symbol's inline cache");
+    lval_delete(result);
+
+    lval* w = lval_num(8);
+    lenv_put(e, k, w);
+    result = lenv_get_cached(e, k);
+    mu_assert(result->num == 8,
+              "A cached lookup should see the binding's current value");
+    lval_delete(result);
+
+    lval_delete(w);
+    lval_delete(v);
+    lval_delete(k);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lenv_get_cached_shadowed) {
+    lenv* g = lenv_new();
+    lval* k = lval_sym("shadowed");
+    lval* v = lval_num(1);
+    lenv_put(g, k, v);
+    lval_delete(lenv_get_cached(g, k));
+
+    lenv* f = lenv_new();
+    f->par = g;
+    lval* w = lval_num(2);
+    lenv_put(f, k, w);
+    lval* result = lenv_get_cached(f, k);
+    mu_assert(result->num == 2,
+              "A local binding should shadow a cached global one");
+    lval_delete(result);
+
+    lenv_delete(f);
+    result = lenv_get_cached(g, k);
+    mu_assert(result->num == 1,
+              "Deleting the local frame should not leave a stale cache");
+    lval_delete(result);
+
+    lval_delete(w);
+    lval_delete(v);
+    lval_delete(k);
+    lenv_delete(g);
+}
+
+MU_TEST(test_lenv_builtin_name) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    mu_assert(strcmp(lenv_builtin_name(builtin_add), "+") == 0,
+              "The registry should name builtin_add +");
+    mu_assert(strcmp(lenv_builtin_name(builtin_head), "head") == 0,
+              "The registry should name builtin_head head");
+    lenv_delete(e);
+}
+
+MU_TEST(test_lenv_fork_shares_parent) {
+    lenv* e = lenv_new();
+    char name[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(name, sizeof(name), "p%d", i);
+        lval* k = lval_sym(name);
+        lval* v = lval_num(i);
+        lenv_put(e, k, v);
+        lval_delete(k);
+        lval_delete(v);
+    }
+
+    lenv* f = lenv_fork(e);
+    mu_assert(f->count == 0,
+              "Forking should not copy any bindings");
+
+    lval* k = lval_sym("p7");
+    lval* result = lenv_get(f, k);
+    mu_assert(result->num == 7,
+              "A fork should see its parent's bindings");
+    lval_delete(result);
+
+    lval* v = lval_num(-7);
+    lenv_def(f, k, v);
+    result = lenv_get(f, k);
+    mu_assert(result->num == -7,
+              "Defining in a fork should shadow the parent's binding");
+    lval_delete(result);
+    result = lenv_get(e, k);
+    mu_assert(result->num == 7,
+              "Defining in a fork should leave the parent alone");
+    lval_delete(result);
+    mu_assert(f->count == 1,
+              "A fork should only hold what was bound in it");
+
+    lenv_delete(f);
+    mu_assert(e->refs == 1,
+              "Deleting a fork should release its parent");
+    lval_delete(v);
+    lval_delete(k);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lenv_stats_counts_lookups) {
+    lenv* e = lenv_new();
+    lenv* child = lenv_new();
+    child->par = e;
+    lval* k = lval_sym("counted");
+    lval* v = lval_num(1);
+    lenv_put(e, k, v);
+
+    lenv_stats before = *lenv_get_stats();
+    lval* result = lenv_get(child, k);
+    lval_delete(result);
+    lval* other = lval_sym("never-bound");
+    result = lenv_get(child, other);
+    lval_delete(result);
+    lenv_stats* after = lenv_get_stats();
+
+    mu_assert(after->lookups == before.lookups + 2,
+              "Every lenv_get should count as a lookup");
+    mu_assert(after->misses == before.misses + 1,
+              "An unbound symbol should count as a miss");
+    mu_assert(after->frames_walked == before.frames_walked + 4,
+              "A lookup should count each frame it searches");
+    mu_assert(after->bytes > 0,
+              "Binding tables should count towards bytes held");
+
+    lval_delete(other);
+    lval_delete(v);
+    lval_delete(k);
+    lenv_delete(child);
+    lenv_delete(e);
+}
+
 MU_TEST_SUITE(lenv_add_remove_suite) {
     MU_RUN_TEST(test_lenv_get_success);
     MU_RUN_TEST(test_lenv_get_not_found);
     MU_RUN_TEST(test_lenv_lookup_sym_success);
+    MU_RUN_TEST(test_lenv_builtin_name);
+    MU_RUN_TEST(test_lenv_fork_shares_parent);
+    MU_RUN_TEST(test_lenv_stats_counts_lookups);
+    MU_RUN_TEST(test_lenv_many_bindings);
+    MU_RUN_TEST(test_lenv_get_cached_hit);
+    MU_RUN_TEST(test_lenv_get_cached_shadowed);
 }
 
 int main() {
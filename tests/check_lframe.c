@@ -0,0 +1,94 @@
+#include "../src/lenv.h"
+#include "../src/lframe.h"
+#include "../src/lsym.h"
+#include "../src/lval.h"
+#include "minunit/minunit.h"
+
+MU_TEST(test_lframe_push_pop) {
+    lenv* par = lenv_new();
+    lenv* a = lframe_push(par, 2);
+    lval* k = lval_sym("x");
+    lenv_bind(a, k->sym, lval_num(1));
+
+    lenv* b = lframe_push(a, 1);
+    mu_assert(b->par == a && (char*)b > (char*)a,
+              "A pushed frame should sit above its caller's");
+    mu_assert(lframe_depth() == 2,
+              "Two pushes should give a depth of 2");
+    lval* result = lenv_get(b, k);
+    mu_assert(result->num == 1,
+              "A frame should see its caller's bindings");
+    lval_delete(result);
+
+    lframe_pop(b);
+    lenv* c = lframe_push(a, 1);
+    mu_assert(c == b,
+              "Popping a frame should make its space available again");
+    lframe_pop(c);
+    lframe_pop(a);
+    mu_assert(lframe_depth() == 0,
+              "Popping every frame should give a depth of 0");
+
+    lval_delete(k);
+    lenv_delete(par);
+}
+
+MU_TEST(test_lframe_spills_to_new_chunk) {
+    int n = LFRAME_CHUNK_BYTES / (sizeof(lenv) + 2 * sizeof(void*)) + 10;
+    lenv** frames = malloc(sizeof(lenv*) * n);
+    lenv* par = NULL;
+    for (int i = 0; i < n; i++) {
+        frames[i] = lframe_push(par, 1);
+        lenv_bind(frames[i], lsym_intern("depth"), lval_num(i));
+        par = frames[i];
+    }
+
+    lval* k = lval_sym("depth");
+    lval* result = lenv_get(frames[n - 1], k);
+    mu_assert(result->num == n - 1,
+              "Frames beyond the first chunk should still bind normally");
+    lval_delete(result);
+    result = lenv_get(frames[0], k);
+    mu_assert(result->num == 0,
+              "Spilling to a new chunk should leave earlier frames in place");
+    lval_delete(result);
+
+    for (int i = n - 1; i >= 0; i--) {
+        lframe_pop(frames[i]);
+    }
+    mu_assert(lframe_depth() == 0,
+              "Popping every frame should give a depth of 0");
+    lval_delete(k);
+    free(frames);
+}
+
+MU_TEST(test_lframe_grows_to_heap) {
+    lenv* e = lframe_push(NULL, 1);
+    char name[16];
+    for (int i = 0; i < 20; i++) {
+        snprintf(name, sizeof(name), "v%d", i);
+        lenv_bind(e, lsym_intern(name), lval_num(i));
+    }
+
+    mu_assert(e->on_stack == 0,
+              "A frame outgrowing its record should move its bindings to the heap");
+    lval* k = lval_sym("v0");
+    lval* result = lenv_get(e, k);
+    mu_assert(result->num == 0,
+              "Moving to the heap should keep earlier bindings");
+    lval_delete(result);
+    lval_delete(k);
+    lframe_pop(e);
+}
+
+MU_TEST_SUITE(lframe_suite) {
+    MU_RUN_TEST(test_lframe_push_pop);
+    MU_RUN_TEST(test_lframe_spills_to_new_chunk);
+    MU_RUN_TEST(test_lframe_grows_to_heap);
+}
+
+int main() {
+    MU_RUN_SUITE(lframe_suite);
+    MU_REPORT();
+    MU_RETURN_VALUE();
+}
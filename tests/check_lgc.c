@@ -0,0 +1,82 @@
+#include "../src/lenv.h"
+#include "../src/lval.h"
+#include "../src/lgc.h"
+#include "minunit/minunit.h"
+
+#ifdef LISPY_GC
+
+MU_TEST(test_lgc_reclaims_leaked_values) {
+    lenv* e = lenv_new();
+    lgc_add_root_env(e);
+    lgc_collect();
+    unsigned long before = lgc_live();
+
+    // Never deleted, so only the collector can get it back
+    lval* leaked = lval_qexpr();
+    leaked = lval_add(leaked, lval_str("gone"));
+    leaked = lval_add(leaked, lval_num(100000));
+    mu_assert(lgc_live() == before + 3,
+              "A list of two values should track three nodes");
+
+    lgc_collect();
+    mu_assert(lgc_live() == before,
+              "Unreachable values should be reclaimed");
+
+    lgc_remove_root_env(e);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lgc_keeps_reachable_values) {
+    lenv* e = lenv_new();
+    lgc_add_root_env(e);
+
+    lval* k = lval_sym("kept");
+    lval* q = lval_add(lval_qexpr(), lval_str("still here"));
+    lenv_put(e, k, q);
+    lval_delete(k);
+
+    // A leaked holder of the bound list must give its reference back
+    lval* leaked = lval_add(lval_qexpr(), q);
+    (void)leaked;
+
+    lgc_collect();
+    mu_assert(q->refs == 1,
+              "The environment should hold the only remaining reference");
+    mu_assert(strcmp(q->cell[0]->str, "still here") == 0,
+              "Values bound in a root environment should survive collection");
+
+    lgc_remove_root_env(e);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lgc_keeps_pushed_roots) {
+    lgc_collect();
+    unsigned long before = lgc_live();
+
+    lval* v = lval_add(lval_sexpr(), lval_str("pinned"));
+    lgc_push_root(v);
+    lgc_collect();
+    mu_assert(lgc_live() == before + 2,
+              "Values pushed as roots should survive collection");
+    lgc_pop_root();
+
+    lgc_collect();
+    mu_assert(lgc_live() == before,
+              "Popped roots should no longer keep values alive");
+}
+
+#endif
+
+MU_TEST_SUITE(lgc_suite) {
+#ifdef LISPY_GC
+    MU_RUN_TEST(test_lgc_reclaims_leaked_values);
+    MU_RUN_TEST(test_lgc_keeps_reachable_values);
+    MU_RUN_TEST(test_lgc_keeps_pushed_roots);
+#endif
+}
+
+int main() {
+    MU_RUN_SUITE(lgc_suite);
+    MU_REPORT();
+    MU_RETURN_VALUE();
+}
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include "../src/lenv.h"
+#include "../src/lmod.h"
+#include "../src/lval.h"
+#include "minunit/minunit.h"
+
+#define MODULE_PATH "check_lmod_module.lspy"
+
+static void write_module(char* contents, time_t mtime) {
+    FILE* f = fopen(MODULE_PATH, "w");
+    fputs(contents, f);
+    fclose(f);
+
+    struct utimbuf times = { mtime, mtime };
+    utime(MODULE_PATH, &times);
+}
+
+static long import_value(lenv* e) {
+    lval* result = builtin_import(e, lval_add(lval_sexpr(),
+                                              lval_str(MODULE_PATH)));
+    lval_delete(result);
+
+    lval* k = lval_sym("value");
+    lval* v = lenv_get(e, k);
+    long n = v->type == LVAL_NUM ? v->num : -1;
+    lval_delete(v);
+    lval_delete(k);
+    return n;
+}
+
+MU_TEST(test_lmod_import_binds_exports) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    write_module("(def {value} 1)", 1000);
+
+    mu_assert(import_value(e) == 1,
+              "Importing a module should bind its definitions");
+    mu_assert(lmod_count() == 1,
+              "Importing a module should cache it");
+
+    lmod_destroy();
+    lenv_delete(e);
+    remove(MODULE_PATH);
+}
+
+MU_TEST(test_lmod_import_once) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    write_module("(def {value} 1)", 1000);
+    import_value(e);
+
+    // Same modification time, so the cached exports should be reused
+    write_module("(def {value} 2)", 1000);
+    mu_assert(import_value(e) == 1,
+              "Importing an unchanged module again should not evaluate it");
+    mu_assert(lmod_count() == 1,
+              "Importing a module twice should cache it once");
+
+    write_module("(def {value} 3)", 2000);
+    mu_assert(import_value(e) == 3,
+              "Importing a modified module should evaluate it again");
+
+    lmod_destroy();
+    lenv_delete(e);
+    remove(MODULE_PATH);
+}
+
+MU_TEST(test_lmod_reload_constants) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    write_module("(defconst {value} 1)", 1000);
+    mu_assert(import_value(e) == 1,
+              "Importing a module should bind its constants");
+
+    write_module("(defconst {value} 2)", 2000);
+    mu_assert(import_value(e) == 2,
+              "Reloading a module should replace its constants");
+
+    lval* q = lval_add(lval_qexpr(), lval_sym("value"));
+    lval* result = builtin_def(e, lval_add(lval_add(lval_sexpr(), q),
+                                           lval_num(3)));
+    mu_assert(result->type == LVAL_ERR,
+              "An imported constant should still be a constant");
+    lval_delete(result);
+
+    lmod_destroy();
+    lenv_delete(e);
+    remove(MODULE_PATH);
+}
+
+// Evaluate each expression in src, returning the value of the last
+static lval* eval_str(lenv* e, char* src) {
+    mpc_result_t r;
+    mpc_parse("<test>", src, Lispy, &r);
+    lval* exprs = lval_read(r.output);
+    mpc_ast_delete(r.output);
+
+    lval* x = lval_sexpr();
+    while (exprs->count) {
+        lval_delete(x);
+        x = lval_eval(e, lval_pop(exprs, 0));
+    }
+    lval_delete(exprs);
+    return x;
+}
+
+static long eval_num(lenv* e, char* src) {
+    lval* x = eval_str(e, src);
+    long n = x->type == LVAL_NUM ? x->num : -1;
+    lval_delete(x);
+    return n;
+}
+
+MU_TEST(test_lmod_import_keeps_importer_constants) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval_delete(eval_str(e, "(defconst {value} 3)"));
+    lval_delete(eval_str(e, "(fun {g _} {value})"));
+
+    write_module("(defconst {value} 4)", 1000);
+    lval* result = eval_str(e, "(import \"" MODULE_PATH "\")");
+    mu_assert(result->type == LVAL_ERR,
+              "Importing a constant over the importer's should fail");
+    lval_delete(result);
+
+    write_module("(def {other} 1) (def {value} 4)", 2000);
+    result = eval_str(e, "(import \"" MODULE_PATH "\")");
+    mu_assert(result->type == LVAL_ERR,
+              "Importing a definition over the importer's constant should fail");
+    lval_delete(result);
+    mu_assert(eval_num(e, "value") == 3 && eval_num(e, "(g 0)") == 3,
+              "A failed import should leave the constant alone");
+    lval* other = eval_str(e, "other");
+    mu_assert(other->type == LVAL_ERR,
+              "A failed import should bind none of the exports");
+    lval_delete(other);
+
+    lmod_destroy();
+    lenv_delete(e);
+    remove(MODULE_PATH);
+}
+
+MU_TEST(test_lmod_import_in_function) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    write_module("(def {value} 1) (defconst {limit} 2) (fun {twice x} {* 2 x})",
+                 1000);
+    lval_delete(eval_str(e, "(fun {load _} {import \"" MODULE_PATH "\"})"));
+    lval_delete(eval_str(e, "(load 0)"));
+
+    mu_assert(eval_num(e, "value") == 1,
+              "A variable imported in a function should outlive the call");
+    mu_assert(eval_num(e, "limit") == 2,
+              "A constant imported in a function should outlive the call");
+    mu_assert(eval_num(e, "(twice 3)") == 6,
+              "A function imported in a function should outlive the call");
+
+    lmod_destroy();
+    lenv_delete(e);
+    remove(MODULE_PATH);
+}
+
+MU_TEST(test_lmod_exports_redefined_builtins) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    write_module("(fun {head l} {7}) (def {value} 1)", 1000);
+
+    mu_assert(import_value(e) == 1,
+              "Importing a module should bind its definitions");
+    mu_assert(eval_num(e, "(head {1 2})") == 7,
+              "A builtin the module redefined should be exported");
+    lval* x = eval_str(e, "(tail {1 2})");
+    mu_assert(x->type == LVAL_QEXPR && x->count == 1,
+              "Builtins the module left alone should not be touched");
+    lval_delete(x);
+
+    lmod_destroy();
+    lenv_delete(e);
+    remove(MODULE_PATH);
+}
+
+MU_TEST(test_lmod_import_missing) {
+    lval_grammar_init();
+    lenv* e = lenv_new();
+    lval* result = builtin_import(e, lval_add(lval_sexpr(),
+                                              lval_str("no_such_module.lspy")));
+
+    mu_assert(result->type == LVAL_ERR,
+              "Importing a missing file should be an error");
+    mu_assert(lmod_count() == 0,
+              "A failed import should not be cached");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST_SUITE(lmod_suite) {
+    MU_RUN_TEST(test_lmod_import_binds_exports);
+    MU_RUN_TEST(test_lmod_import_once);
+    MU_RUN_TEST(test_lmod_reload_constants);
+    MU_RUN_TEST(test_lmod_import_keeps_importer_constants);
+    MU_RUN_TEST(test_lmod_import_in_function);
+    MU_RUN_TEST(test_lmod_exports_redefined_builtins);
+    MU_RUN_TEST(test_lmod_import_missing);
+}
+
+int main() {
+    MU_RUN_SUITE(lmod_suite);
+    MU_REPORT();
+    MU_RETURN_VALUE();
+}
@@ -0,0 +1,70 @@
+#include "../src/lpool.h"
+#include "minunit/minunit.h"
+
+MU_TEST(test_lpool_reuses_freed_block) {
+    void* a = lpool_alloc(40);
+    lpool_free(a, 40);
+    void* b = lpool_alloc(40);
+
+    mu_assert(a == b,
+              "Allocating after a free of the same size should reuse the block");
+    lpool_free(b, 40);
+    lpool_destroy();
+}
+
+MU_TEST(test_lpool_size_classes) {
+    void* a = lpool_alloc(40);
+    void* b = lpool_alloc(24);
+    lpool* p = lpool_get();
+
+    mu_assert(p->classes[2].allocs == 1,
+              "A 40 byte allocation should come from the 48 byte class");
+    mu_assert(p->classes[1].allocs == 1,
+              "A 24 byte allocation should come from the 32 byte class");
+    lpool_free(a, 40);
+    lpool_free(b, 24);
+    lpool_destroy();
+}
+
+MU_TEST(test_lpool_hit_counts) {
+    void* a = lpool_alloc(16);
+    lpool_free(a, 16);
+    a = lpool_alloc(16);
+    lpool* p = lpool_get();
+
+    mu_assert(p->classes[0].allocs == 2,
+              "Two allocations should be counted");
+    mu_assert(p->classes[0].frees == 1,
+              "One free should be counted");
+    mu_assert(p->classes[0].nslabs == 1,
+              "Both allocations should fit in a single slab");
+    mu_assert(p->classes[0].hits == 1,
+              "The first allocation carves a slab, the second is a hit");
+    lpool_free(a, 16);
+    lpool_destroy();
+}
+
+MU_TEST(test_lpool_large_allocation) {
+    void* a = lpool_alloc(LPOOL_GRANULE * LPOOL_CLASSES + 1);
+    lpool* p = lpool_get();
+
+    mu_assert(p->large_allocs == 1,
+              "Allocations bigger than the largest class go to malloc");
+    lpool_free(a, LPOOL_GRANULE * LPOOL_CLASSES + 1);
+    mu_assert(p->large_frees == 1,
+              "Freeing a large allocation should be counted");
+    lpool_destroy();
+}
+
+MU_TEST_SUITE(lpool_suite) {
+    MU_RUN_TEST(test_lpool_reuses_freed_block);
+    MU_RUN_TEST(test_lpool_size_classes);
+    MU_RUN_TEST(test_lpool_hit_counts);
+    MU_RUN_TEST(test_lpool_large_allocation);
+}
+
+int main() {
+    MU_RUN_SUITE(lpool_suite);
+    MU_REPORT();
+    MU_RETURN_VALUE();
+}
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/lsym.h"
+#include "minunit/minunit.h"
+
+MU_TEST(test_lsym_same_name_same_pointer) {
+    char name[] = "sup";
+    char* a = lsym_intern("sup");
+    char* b = lsym_intern(name);
+
+    mu_assert(a == b,
+              "Interning equal names should return the same pointer");
+    mu_assert(a != name,
+              "Interning should not keep the caller's buffer");
+    mu_assert(strcmp(a, "sup") == 0,
+              "Interned name should match the original");
+    lsym_destroy();
+}
+
+MU_TEST(test_lsym_different_names) {
+    char* a = lsym_intern("head");
+    char* b = lsym_intern("tail");
+
+    mu_assert(a != b,
+              "Different names should intern to different pointers");
+    mu_assert(lsym_count() == 2,
+              "Two different names should be stored");
+    lsym_destroy();
+}
+
+MU_TEST(test_lsym_survives_growth) {
+    char* first = lsym_intern("first");
+    char name[32];
+    for (int i = 0; i < LSYM_INITIAL_CAPACITY * 4; i++) {
+        snprintf(name, sizeof(name), "sym-%d", i);
+        lsym_intern(name);
+    }
+
+    mu_assert(lsym_intern("first") == first,
+              "Growing the table should not move interned names");
+    mu_assert(lsym_count() == LSYM_INITIAL_CAPACITY * 4 + 1,
+              "Every distinct name should be stored once");
+    mu_assert(lsym_of(first)->name == first,
+              "lsym_of should recover the entry of an interned name");
+    lsym_destroy();
+}
+
+MU_TEST_SUITE(lsym_suite) {
+    MU_RUN_TEST(test_lsym_same_name_same_pointer);
+    MU_RUN_TEST(test_lsym_different_names);
+    MU_RUN_TEST(test_lsym_survives_growth);
+}
+
+int main() {
+    MU_RUN_SUITE(lsym_suite);
+    MU_REPORT();
+    MU_RETURN_VALUE();
+}
@@ -1,5 +1,8 @@
+#include "../src/lcode.h"
 #include "../src/lval.h"
 #include "../src/lenv.h"
+#include "../src/lpool.h"
+#include "../src/lsym.h"
 #include "minunit/minunit.h"
 
 // builtin(lval*, char* op)
@@ -25,7 +28,8 @@ MU_TEST(test_lval_cons) {
     mu_assert(result->cell[0]->num == 1,
               "Cons should put the number one in front");
 
-    lval_delete(v);
+    lval_delete(result);
+    lenv_delete(e);
 }
 
 MU_TEST(test_lval_list_success) {
@@ -922,6 +926,201 @@ MU_TEST(test_lval_and_fail_multiple) {
     lval_delete(result);
 }
 
+MU_TEST(test_lval_if_evaluates_one_branch) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* sum = lval_sexpr();
+    sum = lval_add(sum, lval_sym("+"));
+    sum = lval_add(sum, lval_num(1));
+    sum = lval_add(sum, lval_num(2));
+
+    lval* a = lval_sexpr();
+    a = lval_add(a, lval_num(1));
+    a = lval_add(a, sum);
+    a = lval_add(a, lval_sym("undefined-sym"));
+    lval* result = builtin_if(e, a);
+    mu_assert(result->type == LVAL_NUM && result->num == 3,
+              "(if 1 (+ 1 2) undefined-sym) should result in 3");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_or_short_circuits) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* t = lval_sexpr();
+    t = lval_add(t, lval_num(1));
+    t = lval_add(t, lval_sym("undefined-sym"));
+    lval* result = builtin_or(e, t);
+    mu_assert(result->type == LVAL_NUM && result->num == 1,
+              "(or 1 undefined-sym) should return 1 without evaluating "\
+              "undefined-sym");
+    lval_delete(result);
+
+    t = lval_sexpr();
+    t = lval_add(t, lval_num(0));
+    t = lval_add(t, lval_sym("undefined-sym"));
+    result = builtin_or(e, t);
+    mu_assert(result->type == LVAL_ERR,
+              "(or 0 undefined-sym) should evaluate undefined-sym");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_and_short_circuits) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* t = lval_sexpr();
+    t = lval_add(t, lval_num(0));
+    t = lval_add(t, lval_sym("undefined-sym"));
+    lval* result = builtin_and(e, t);
+    mu_assert(result->type == LVAL_NUM && result->num == 0,
+              "(and 0 undefined-sym) should return 0 without evaluating "\
+              "undefined-sym");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_cond) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* skipped = lval_qexpr();
+    skipped = lval_add(skipped, lval_num(0));
+    skipped = lval_add(skipped, lval_sym("undefined-sym"));
+    lval* taken = lval_qexpr();
+    taken = lval_add(taken, lval_num(1));
+    taken = lval_add(taken, lval_sym("+"));
+    taken = lval_add(taken, lval_num(2));
+    taken = lval_add(taken, lval_num(3));
+
+    lval* a = lval_sexpr();
+    a = lval_add(a, skipped);
+    a = lval_add(a, taken);
+    a = lval_add(a, lval_sym("undefined-sym"));
+    lval* result = builtin_cond(e, a);
+    mu_assert(result->type == LVAL_NUM && result->num == 5,
+              "cond should run the body of the first true clause only");
+    lval_delete(result);
+
+    a = lval_add(lval_sexpr(), lval_add(lval_qexpr(), lval_num(0)));
+    result = builtin_cond(e, a);
+    mu_assert(result->type == LVAL_SEXPR && result->count == 0,
+              "cond with no true clause should return ()");
+    lval_delete(result);
+
+    a = lval_add(lval_sexpr(), lval_add(lval_qexpr(), lval_num(7)));
+    result = builtin_cond(e, a);
+    mu_assert(result->type == LVAL_NUM && result->num == 7,
+              "A true clause without a body should return its test");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_when_unless) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* a = lval_sexpr();
+    a = lval_add(a, lval_num(1));
+    a = lval_add(a, lval_num(2));
+    a = lval_add(a, lval_add(lval_qexpr(), lval_num(3)));
+    lval* result = builtin_when(e, a);
+    mu_assert(result->type == LVAL_NUM && result->num == 3,
+              "(when 1 2 {3}) should return 3");
+    lval_delete(result);
+
+    a = lval_sexpr();
+    a = lval_add(a, lval_num(1));
+    a = lval_add(a, lval_sym("undefined-sym"));
+    result = builtin_unless(e, a);
+    mu_assert(result->type == LVAL_SEXPR && result->count == 0,
+              "(unless 1 undefined-sym) should return () without "\
+              "evaluating undefined-sym");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+static lval* num_list(int n) {
+    lval* q = lval_qexpr();
+    for (int i = 1; i <= n; i++) {
+        q = lval_add(q, lval_num(i));
+    }
+    return q;
+}
+
+/* Whether fixed and func agree on args, which is consumed. */
+static int fixed_matches(lenv* e, lfixed fixed, lbuiltin func, lval* args) {
+    lval* fast = fixed(e, args->cell);
+    lval* slow = func(e, args);
+    int same = fast && lval_eq(fast, slow);
+    if (fast) {
+        lval_delete(fast);
+    }
+    lval_delete(slow);
+    return same;
+}
+
+static lval* args1(lval* x) {
+    return lval_add(lval_sexpr(), x);
+}
+
+static lval* args2(lval* x, lval* y) {
+    return lval_add(lval_add(lval_sexpr(), x), y);
+}
+
+MU_TEST(test_lval_fixed_matches_builtin) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    mu_assert(fixed_matches(e, fixed_add, builtin_add,
+                            args2(lval_num(7), lval_num(3))),
+              "fixed_add should match builtin_add");
+    mu_assert(fixed_matches(e, fixed_sub, builtin_sub,
+                            args2(lval_num(7), lval_num(3))),
+              "fixed_sub should match builtin_sub");
+    mu_assert(fixed_matches(e, fixed_lt, builtin_lt,
+                            args2(lval_num(7), lval_num(3))),
+              "fixed_lt should match builtin_lt");
+    mu_assert(fixed_matches(e, fixed_eq, builtin_eq,
+                            args2(num_list(2), num_list(2))),
+              "fixed_eq should match builtin_eq");
+
+    mu_assert(fixed_matches(e, fixed_head, builtin_head, args1(num_list(3))),
+              "fixed_head should match builtin_head");
+    mu_assert(fixed_matches(e, fixed_tail, builtin_tail, args1(num_list(3))),
+              "fixed_tail should match builtin_tail");
+    mu_assert(fixed_matches(e, fixed_len, builtin_len, args1(num_list(3))),
+              "fixed_len should match builtin_len");
+    mu_assert(fixed_matches(e, fixed_head, builtin_head,
+                            args1(lval_str("abc"))),
+              "fixed_head should match builtin_head on a string");
+    mu_assert(fixed_matches(e, fixed_tail, builtin_tail,
+                            args1(lval_str("abc"))),
+              "fixed_tail should match builtin_tail on a string");
+    mu_assert(fixed_matches(e, fixed_not, builtin_not, args1(lval_num(0))),
+              "fixed_not should match builtin_not");
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_fixed_declines_bad_arguments) {
+    lenv* e = lenv_new();
+    lval* a = args2(lval_num(1), lval_qexpr());
+    mu_assert(fixed_add(e, a->cell) == NULL,
+              "fixed_add should leave a non-number to builtin_add");
+    mu_assert(fixed_lt(e, a->cell) == NULL,
+              "fixed_lt should leave a non-number to builtin_lt");
+    mu_assert(fixed_head(e, a->cell + 1) == NULL,
+              "fixed_head should leave {} to builtin_head");
+    mu_assert(fixed_len(e, a->cell) == NULL,
+              "fixed_len should leave a number to builtin_len");
+    lval_delete(a);
+    lenv_delete(e);
+}
+
 MU_TEST(test_lval_not_success) {
     lenv* e = lenv_new();
     lenv_add_builtins(e);
@@ -986,6 +1185,13 @@ MU_TEST_SUITE(builtin_suite) {
     MU_RUN_TEST(test_lval_and_success);
     MU_RUN_TEST(test_lval_and_success_multiple);
     MU_RUN_TEST(test_lval_and_fail_multiple);
+    MU_RUN_TEST(test_lval_if_evaluates_one_branch);
+    MU_RUN_TEST(test_lval_or_short_circuits);
+    MU_RUN_TEST(test_lval_and_short_circuits);
+    MU_RUN_TEST(test_lval_cond);
+    MU_RUN_TEST(test_lval_when_unless);
+    MU_RUN_TEST(test_lval_fixed_matches_builtin);
+    MU_RUN_TEST(test_lval_fixed_declines_bad_arguments);
     MU_RUN_TEST(test_lval_not_success);
 }
 
@@ -1040,16 +1246,726 @@ MU_TEST(test_lval_copy_sandqexpr) {
     lval_delete(v);
 }
 
+MU_TEST(test_lval_copy_shares) {
+    lval* v = lval_qexpr();
+    v = lval_add(v, lval_num(14));
+    lval* x = lval_copy(v);
+
+    mu_assert(x == v,
+              "Copy should share the value instead of duplicating it");
+    mu_assert(v->refs == 2,
+              "Copy should take a reference");
+    lval_delete(x);
+    mu_assert(v->refs == 1,
+              "Deleting a copy should only drop its reference");
+    lval_delete(v);
+}
+
+MU_TEST(test_lval_unshare_copies_on_write) {
+    lval* v = lval_qexpr();
+    v = lval_add(v, lval_num(14));
+    v = lval_add(v, lval_num(15));
+    lval* x = lval_unshare(lval_copy(v));
+
+    mu_assert(x != v,
+              "Unsharing a shared value should produce a new value");
+    lval_delete(lval_pop(x, 0));
+    mu_assert(v->count == 2,
+              "Mutating the unshared value should leave the original alone");
+    mu_assert(x->count == 1,
+              "Mutating the unshared value should change it");
+    lval_delete(x);
+    lval_delete(v);
+}
+
+MU_TEST(test_lval_eval_bound_qexpr_unchanged) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* q = lval_qexpr();
+    q = lval_add(q, lval_sym("+"));
+    q = lval_add(q, lval_num(1));
+    q = lval_add(q, lval_num(2));
+    lval* k = lval_sym("q");
+    lenv_put(e, k, q);
+
+    lval* result = builtin_eval(e, lval_add(lval_sexpr(), lenv_get(e, k)));
+    mu_assert(result->num == 3,
+              "Eval of a bound {+ 1 2} should result in 3");
+
+    lval* stored = lenv_get(e, k);
+    mu_assert(stored->type == LVAL_QEXPR,
+              "Eval should not retag the Qexpr stored in the environment");
+    mu_assert(stored->count == 3,
+              "Eval should not consume the Qexpr stored in the environment");
+
+    lval_delete(stored);
+    lval_delete(result);
+    lval_delete(k);
+    lval_delete(q);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_unshare_lambda_shares_env) {
+    lval* f = lval_lambda(lval_add(lval_qexpr(), lval_sym("x")),
+                          lval_add(lval_qexpr(), lval_sym("x")));
+    lval* g = lval_unshare(lval_copy(f));
+
+    mu_assert(g != f && g->env == f->env,
+              "Unsharing a lambda should share its frame, not copy it");
+    mu_assert(f->env->refs == 2,
+              "A shared frame should count both lambdas");
+    lval_delete(g);
+    mu_assert(f->env->refs == 1,
+              "Deleting a lambda should release its frame");
+    lval_delete(f);
+}
+
+MU_TEST(test_lval_partial_application_frame_unchanged) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* body = lval_qexpr();
+    body = lval_add(body, lval_sym("-"));
+    body = lval_add(body, lval_sym("x"));
+    body = lval_add(body, lval_sym("y"));
+    lval* formals = lval_add(lval_add(lval_qexpr(), lval_sym("x")),
+                             lval_sym("y"));
+    lval* f = lval_lambda(formals, body);
+
+    lval* partial = lval_call(e, f, lval_add(lval_sexpr(), lval_num(10)));
+    mu_assert(partial->type == LVAL_FUN && partial->env->count == 1,
+              "Partial application should bind the first argument");
+
+    for (int i = 0; i < 2; i++) {
+        lval* result = lval_call(e, partial, lval_add(lval_sexpr(), lval_num(i)));
+        mu_assert(result->num == 10 - i,
+                  "Calling a partial application should use its bound argument");
+        lval_delete(result);
+    }
+    mu_assert(partial->env->count == 1 && partial->env->refs == 1,
+              "Calling a partial application should not bind into its frame");
+
+    lval_delete(partial);
+    lval_delete(f);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_fun_remembers_name) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    lval* args = lval_add(lval_add(lval_qexpr(), lval_sym("add")), lval_sym("x"));
+    lval* body = lval_add(lval_add(lval_qexpr(), lval_sym("+")), lval_sym("x"));
+    lval* result = builtin_fun(e, lval_add(lval_add(lval_sexpr(), args), body));
+    mu_assert(result->env->name == lsym_intern("add"),
+              "fun should name the lambda it defines");
+    lval_delete(result);
+
+    lval* k = lval_sym("add");
+    lval* f = lenv_get(e, k);
+    lval* q = lval_add(lval_qexpr(), lval_sym("plus"));
+    result = builtin_def(e, lval_add(lval_add(lval_sexpr(), q), f));
+    lval_delete(result);
+    f = lenv_get(e, k);
+    mu_assert(f->env->name == lsym_intern("add"),
+              "Defining a named lambda again should keep its first name");
+
+    lval_delete(f);
+    lval_delete(k);
+    lenv_delete(e);
+}
+
 MU_TEST_SUITE(lval_copy_suite) {
     MU_RUN_TEST(test_lval_copy_num);
     MU_RUN_TEST(test_lval_copy_err);
     MU_RUN_TEST(test_lval_copy_sym);
     MU_RUN_TEST(test_lval_copy_sandqexpr);
+    MU_RUN_TEST(test_lval_copy_shares);
+    MU_RUN_TEST(test_lval_unshare_copies_on_write);
+    MU_RUN_TEST(test_lval_eval_bound_qexpr_unchanged);
+    MU_RUN_TEST(test_lval_unshare_lambda_shares_env);
+    MU_RUN_TEST(test_lval_partial_application_frame_unchanged);
+    MU_RUN_TEST(test_lval_fun_remembers_name);
+}
+
+MU_TEST(test_lval_add_grows_geometrically) {
+    lval* v = lval_qexpr();
+    int reallocs = 0;
+    int cap = 0;
+    for (int i = 0; i < 1000; i++) {
+        v = lval_add(v, lval_num(i));
+        if (v->buf->cap != cap) {
+            reallocs++;
+            cap = v->buf->cap;
+        }
+    }
+
+    mu_assert(v->count == 1000,
+              "Adding 1000 values should result in a list of 1000");
+    mu_assert(v->buf->cap >= v->count,
+              "Capacity should cover every value in the list");
+    mu_assert(reallocs <= 10,
+              "Adding 1000 values should only resize a handful of times");
+    mu_assert(v->cell[999]->num == 999,
+              "Values should be kept in order");
+    lval_delete(v);
+}
+
+MU_TEST(test_lval_pop_shrinks) {
+    lval* v = lval_qexpr();
+    for (int i = 0; i < 1000; i++) {
+        v = lval_add(v, lval_num(i));
+    }
+    while (v->count > 1) {
+        lval_delete(lval_pop(v, v->count - 1));
+    }
+
+    mu_assert(v->buf->cap < 1000 / 4,
+              "Draining a list should give back its unused capacity");
+    mu_assert(v->cell[0]->num == 0,
+              "Popping from the back should leave the front alone");
+    lval_delete(v);
+}
+
+MU_TEST(test_lval_reserve_exact) {
+    lval* v = lval_reserve(lval_qexpr(), 10);
+
+    mu_assert(v->buf->cap == 10,
+              "Reserve should size the list exactly");
+    mu_assert(v->count == 0,
+              "Reserve should not change the number of values");
+    lval_delete(v);
+}
+
+MU_TEST(test_lval_pop_front_constant_time) {
+    lval* v = lval_qexpr();
+    for (int i = 0; i < 100; i++) {
+        v = lval_add(v, lval_num(i));
+    }
+    lval** second = &v->cell[1];
+    lval* x = lval_pop(v, 0);
+
+    mu_assert(x->num == 0,
+              "Popping the front should return the first value");
+    mu_assert(v->cell == second,
+              "Popping the front should advance the view, not move cells");
+    mu_assert(v->cell[0]->num == 1,
+              "The second value should now be first");
+    lval_delete(x);
+    lval_delete(v);
+}
+
+MU_TEST(test_lval_tail_shares_cells) {
+    lenv* e = lenv_new();
+    lval* q = lval_qexpr();
+    for (int i = 0; i < 100; i++) {
+        q = lval_add(q, lval_num(i));
+    }
+
+    lval* result = builtin_tail(e, lval_add(lval_sexpr(), lval_copy(q)));
+    mu_assert(result->buf == q->buf,
+              "Tail of a shared list should be a view of the same cells");
+    mu_assert(result->count == 99,
+              "Tail of a list of 100 should have 99 values");
+    mu_assert(result->cell[0]->num == 1,
+              "Tail should start at the second value");
+    mu_assert(q->count == 100 && q->cell[0]->num == 0,
+              "Tail should leave the original list alone");
+
+    result = lval_add(result, lval_num(100));
+    mu_assert(result->buf != q->buf,
+              "Adding to a view should copy it instead of writing to shared cells");
+    mu_assert(q->count == 100,
+              "Adding to the tail should leave the original list alone");
+
+    lval_delete(result);
+    lval_delete(q);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_cons_reuses_front_slot) {
+    lenv* e = lenv_new();
+    lval* q = lval_qexpr();
+    for (int i = 0; i < 10; i++) {
+        q = lval_add(q, lval_num(i));
+    }
+    lval_delete(lval_pop(q, 0));
+    lcells* b = q->buf;
+
+    lval* args = lval_add(lval_add(lval_sexpr(), lval_num(42)), q);
+    lval* result = builtin_cons(e, args);
+    mu_assert(result->buf == b && result->cell == b->items,
+              "Cons after a pop from the front should reuse the freed slot");
+    mu_assert(result->cell[0]->num == 42 && result->cell[1]->num == 1,
+              "Cons should put the new value in front");
+
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST_SUITE(lval_list_suite) {
+    MU_RUN_TEST(test_lval_add_grows_geometrically);
+    MU_RUN_TEST(test_lval_pop_shrinks);
+    MU_RUN_TEST(test_lval_reserve_exact);
+    MU_RUN_TEST(test_lval_pop_front_constant_time);
+    MU_RUN_TEST(test_lval_tail_shares_cells);
+    MU_RUN_TEST(test_lval_cons_reuses_front_slot);
+}
+
+static lval* test_clist(int n) {
+    lval* v = lval_nil();
+    for (int i = n - 1; i >= 0; i--) {
+        v = lval_cons(lval_num(i), v);
+    }
+    return v;
+}
+
+MU_TEST(test_lval_cons_list_shares_tail) {
+    lenv* e = lenv_new();
+    lval* xs = test_clist(3);
+
+    lval* args = lval_add(lval_add(lval_sexpr(), lval_num(42)), lval_copy(xs));
+    lval* result = builtin_cons(e, args);
+    mu_assert(result->type == LVAL_CONS,
+              "Cons onto a Cons-List should result in a Cons-List");
+    mu_assert(result->cdr == xs,
+              "Cons should share the list it was given, not copy it");
+    mu_assert(result->len == 4,
+              "Cons onto a list of 3 should have length 4");
+
+    lval* tail = builtin_tail(e, lval_add(lval_sexpr(), lval_copy(result)));
+    mu_assert(tail == xs,
+              "Tail of a Cons-List should be the list it was built on");
+
+    lval_delete(tail);
+    lval_delete(result);
+    lval_delete(xs);
+    lenv_delete(e);
+}
+
+// Blocks handed out by the pool and not yet returned
+static long pool_live(void) {
+    lpool* p = lpool_get();
+    long n = p->large_allocs - p->large_frees;
+    for (int i = 0; i < LPOOL_CLASSES; i++) {
+        n += p->classes[i].allocs - p->classes[i].frees;
+    }
+    return n;
+}
+
+MU_TEST(test_lval_cons_frees_args) {
+    lenv* e = lenv_new();
+    lval* q = lval_add(lval_qexpr(), lval_num(1));
+    lval* xs = test_clist(2);
+    long live = pool_live();
+
+    for (int i = 0; i < 4; i++) {
+        lval* list = i % 2 ? lval_copy(xs) : lval_copy(q);
+        lval* args = lval_add(lval_add(lval_sexpr(), lval_num(0)), list);
+        lval_delete(builtin_cons(e, args));
+    }
+    mu_assert(pool_live() == live,
+              "Cons should free its arguments along with what it built");
+
+    lval_delete(xs);
+    lval_delete(q);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_cons_list_len) {
+    lenv* e = lenv_new();
+    lval* result = builtin_len(e, lval_add(lval_sexpr(), test_clist(5)));
+    mu_assert(result->num == 5,
+              "Length of a Cons-List of 5 should be 5");
+    lval_delete(result);
+
+    result = builtin_len(e, lval_add(lval_sexpr(), lval_nil()));
+    mu_assert(result->num == 0,
+              "Length of nil should be 0");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_cons_list_join_shares_last) {
+    lenv* e = lenv_new();
+    lval* xs = test_clist(2);
+    lval* ys = test_clist(3);
+
+    lval* args = lval_add(lval_add(lval_sexpr(), lval_copy(xs)), lval_copy(ys));
+    lval* result = builtin_join(e, args);
+    mu_assert(result->len == 5,
+              "Joining lists of 2 and 3 should have length 5");
+    mu_assert(result->cdr->cdr == ys,
+              "Join should share the last list instead of copying it");
+    mu_assert(result->car->num == 0 && result->cdr->cdr->car->num == 0,
+              "Join should keep the values of each list in order");
+
+    lval_delete(result);
+    lval_delete(xs);
+    lval_delete(ys);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_join_mixed_lists) {
+    lenv* e = lenv_new();
+    lval* q = lval_add(lval_add(lval_qexpr(), lval_num(0)), lval_num(1));
+    lval* xs = test_clist(3);
+
+    // (join {0 1} (clist {0 1 2})) is a Q-Expression of 5
+    lval* args = lval_add(lval_add(lval_sexpr(), lval_copy(q)), lval_copy(xs));
+    lval* result = builtin_join(e, args);
+    mu_assert(result->type == LVAL_QEXPR && result->count == 5 &&
+              result->cell[1]->num == 1 && result->cell[4]->num == 2,
+              "Joining onto a Q-Expression should give a Q-Expression");
+    lval_delete(result);
+
+    // (join (clist {0 1 2}) {0 1}) is a Cons-List of 5
+    args = lval_add(lval_add(lval_sexpr(), lval_copy(xs)), lval_copy(q));
+    result = builtin_join(e, args);
+    mu_assert(result->type == LVAL_CONS && result->len == 5 &&
+              result->cdr->cdr->car->num == 2 &&
+              result->cdr->cdr->cdr->cdr->car->num == 1,
+              "Joining onto a Cons-List should give a Cons-List");
+    lval_delete(result);
+
+    lval_delete(xs);
+    lval_delete(q);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_cons_list_eval) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval* xs = lval_cons(lval_sym("+"),
+                         lval_cons(lval_num(1), lval_cons(lval_num(2), lval_nil())));
+
+    lval* result = builtin_eval(e, lval_add(lval_sexpr(), xs));
+    mu_assert(result->type == LVAL_NUM && result->num == 3,
+              "Eval of a Cons-List {+ 1 2} should result in 3");
+
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_cons_list_eq_qexpr) {
+    lval* xs = test_clist(3);
+    lval* q = lval_qexpr();
+    for (int i = 0; i < 3; i++) {
+        q = lval_add(q, lval_num(i));
+    }
+
+    mu_assert(lval_eq(xs, q) && lval_eq(q, xs),
+              "A Cons-List should equal a Qexpr with the same values");
+    lval* empty = lval_qexpr();
+    mu_assert(lval_eq(lval_nil(), empty),
+              "nil should equal {}");
+    lval_delete(empty);
+    lval_delete(lval_pop(q, 2));
+    mu_assert(!lval_eq(xs, q),
+              "Lists of different lengths should not be equal");
+
+    lval_delete(q);
+    lval_delete(xs);
+}
+
+MU_TEST_SUITE(lval_cons_list_suite) {
+    MU_RUN_TEST(test_lval_cons_list_shares_tail);
+    MU_RUN_TEST(test_lval_cons_frees_args);
+    MU_RUN_TEST(test_lval_cons_list_len);
+    MU_RUN_TEST(test_lval_cons_list_join_shares_last);
+    MU_RUN_TEST(test_lval_join_mixed_lists);
+    MU_RUN_TEST(test_lval_cons_list_eval);
+    MU_RUN_TEST(test_lval_cons_list_eq_qexpr);
+}
+
+MU_TEST(test_lval_lambda_resolves_formals) {
+    lenv* e = lenv_new();
+    lval* args = lval_qexpr();
+    args = lval_add(args, lval_sym("a"));
+    args = lval_add(args, lval_sym("&"));
+    args = lval_add(args, lval_sym("b"));
+    lval* body = lval_qexpr();
+    body = lval_add(body, lval_sym("+"));
+    body = lval_add(body, lval_sym("a"));
+    body = lval_add(body, lval_sym("c"));
+    body = lval_add(body, lval_sym("b"));
+
+    lval* result = builtin_lambda(e, lval_add(lval_add(lval_sexpr(), args), body));
+    lval** cell = result->body->cell;
+    mu_assert(cell[1]->slot == 0 && cell[3]->slot == 1,
+              "Formals in a lambda body should be resolved to their frame slots");
+    mu_assert(cell[0]->slot == -1 && cell[2]->slot == -1,
+              "Free symbols in a lambda body should be left for name lookup");
+
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_eval_resolved_sym_wrong_frame) {
+    lenv* e = lenv_new();
+    lval* y = lval_sym("y");
+    lval* x = lval_sym("x");
+    lval* one = lval_num(1);
+    lval* two = lval_num(2);
+    lenv_put(e, y, one);
+    lenv_put(e, x, two);
+
+    // Resolved against a frame where x came first
+    x->slot = 0;
+    lval* result = lval_eval(e, lval_copy(x));
+    mu_assert(result->num == 2,
+              "A symbol whose slot holds another name should be looked up by name");
+
+    lval_delete(result);
+    lval_delete(one);
+    lval_delete(two);
+    lval_delete(x);
+    lval_delete(y);
+    lenv_delete(e);
+}
+
+MU_TEST_SUITE(lval_resolve_suite) {
+    MU_RUN_TEST(test_lval_lambda_resolves_formals);
+    MU_RUN_TEST(test_lval_eval_resolved_sym_wrong_frame);
+}
+
+static lval* test_defconst(lenv* e, char* name, lval* v) {
+    lval* q = lval_add(lval_qexpr(), lval_sym(name));
+    return builtin_defconst(e, lval_add(lval_add(lval_sexpr(), q), v));
+}
+
+MU_TEST(test_lval_defconst_rejects_rebinding) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval_delete(test_defconst(e, "k", lval_num(1)));
+
+    lval* q = lval_add(lval_qexpr(), lval_sym("k"));
+    lval* result = builtin_def(e, lval_add(lval_add(lval_sexpr(), q), lval_num(2)));
+    mu_assert(result->type == LVAL_ERR,
+              "Redefining a constant should be an error");
+    lval_delete(result);
+
+    result = test_defconst(e, "k", lval_num(3));
+    mu_assert(result->type == LVAL_ERR,
+              "Redefining a constant with defconst should be an error");
+    lval_delete(result);
+
+    lval* k = lval_sym("k");
+    result = lenv_get(e, k);
+    mu_assert(result->num == 1,
+              "A constant should keep its value");
+    lval_delete(result);
+
+    lval* formals = lval_add(lval_qexpr(), lval_sym("k"));
+    result = builtin_lambda(e, lval_add(lval_add(lval_sexpr(), formals),
+                                        lval_qexpr()));
+    mu_assert(result->type == LVAL_ERR,
+              "A constant should not be usable as a formal");
+    lval_delete(result);
+
+    lval_delete(k);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_defconst_in_sandbox) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    // (sandbox {defconst {k} 1})
+    lval* code = lval_qexpr();
+    code = lval_add(code, lval_sym("defconst"));
+    code = lval_add(code, lval_add(lval_qexpr(), lval_sym("k")));
+    code = lval_add(code, lval_num(1));
+    lval_delete(builtin_sandbox(e, lval_add(lval_sexpr(), code)));
+
+    lval* q = lval_add(lval_qexpr(), lval_sym("k"));
+    lval* result = builtin_def(e, lval_add(lval_add(lval_sexpr(), q),
+                                           lval_num(2)));
+    mu_assert(result->type != LVAL_ERR,
+              "A constant defined in a sandbox should not outlive it");
+    lval_delete(result);
+
+    lval* formals = lval_add(lval_qexpr(), lval_sym("k"));
+    result = builtin_lambda(e, lval_add(lval_add(lval_sexpr(), formals),
+                                        lval_qexpr()));
+    mu_assert(result->type == LVAL_FUN,
+              "A name made constant in a sandbox should be usable as a "
+              "formal outside it");
+    lval_delete(result);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_lambda_inlines_consts) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+    lval_delete(test_defconst(e, "k", lval_num(5)));
+
+    // (\ {x} {+ x k (len {k})})
+    lval* body = lval_qexpr();
+    body = lval_add(body, lval_sym("+"));
+    body = lval_add(body, lval_sym("x"));
+    body = lval_add(body, lval_sym("k"));
+    lval* len = lval_add(lval_sexpr(), lval_sym("len"));
+    body = lval_add(body, lval_add(len, lval_add(lval_qexpr(),
+                                                 lval_sym("k"))));
+    lval* formals = lval_add(lval_qexpr(), lval_sym("x"));
+    lval* f = builtin_lambda(e, lval_add(lval_add(lval_sexpr(), formals),
+                                         lval_copy(body)));
+
+    lval* code = f->code->body;
+    mu_assert(code->cell[2]->type == LVAL_NUM && code->cell[2]->num == 5,
+              "A constant in the compiled body should be replaced by its value");
+    mu_assert(code->cell[3]->cell[1]->cell[0]->type == LVAL_SYM,
+              "A constant inside a quoted list should be left alone");
+    mu_assert(f->body->cell[2]->type == LVAL_SYM,
+              "The lambda should keep its body as written, for printing");
+    mu_assert(body->cell[2]->type == LVAL_SYM,
+              "Inlining should not change the list the body came from");
+
+    lval* result = lval_call(e, f, lval_add(lval_sexpr(), lval_num(1)));
+    mu_assert(result->type == LVAL_NUM && result->num == 7,
+              "The inlined body should evaluate like the original");
+    lval_delete(result);
+
+    lval_delete(f);
+    lval_delete(body);
+    lenv_delete(e);
+}
+
+// {{{...{leaf}...}}} nested depth times
+static lval* test_nested_qexpr(int depth, long leaf) {
+    lval* v = lval_num(leaf);
+    for (int i = 0; i < depth; i++) {
+        v = lval_add(lval_qexpr(), v);
+    }
+    return v;
+}
+
+// Far deeper than the C stack could recurse
+#define DEEP 1000000
+
+MU_TEST(test_lval_deep_lists) {
+    lval* x = test_nested_qexpr(DEEP, 1);
+    lval* y = test_nested_qexpr(DEEP, 1);
+    lval* z = test_nested_qexpr(DEEP, 2);
+
+    mu_assert(lval_eq(x, y), "Equal deep lists should compare equal");
+    mu_assert(!lval_eq(x, z),
+              "Deep lists differing at the bottom should compare unequal");
+
+    lval_delete(x);
+    lval_delete(y);
+    lval_delete(z);
+}
+
+MU_TEST(test_lval_eval_deep_nesting) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    // (+ 1 (+ 1 ... (+ 1 0)))
+    int n = 100000;
+    lval* v = lval_num(0);
+    for (int i = 0; i < n; i++) {
+        v = lval_add(lval_add(lval_add(lval_sexpr(), lval_sym("+")),
+                              lval_num(1)), v);
+    }
+
+    lval* result = lval_eval(e, lval_copy(v));
+    mu_assert(result->type == LVAL_ERR,
+              "Nesting past the depth limit should be an error");
+    lval_delete(result);
+
+    int old = lval_set_max_depth(n + 10);
+    result = lval_eval(e, v);
+    mu_assert(result->type == LVAL_NUM && result->num == n,
+              "Deep nesting within the limit should evaluate");
+    lval_delete(result);
+    lval_set_max_depth(old);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_call_depth_limit) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    // (fun {f x} {+ 1 (f x)}) never returns
+    lval* call = lval_add(lval_add(lval_sexpr(), lval_sym("f")),
+                          lval_sym("x"));
+    lval* body = lval_add(lval_add(lval_add(lval_qexpr(), lval_sym("+")),
+                                   lval_num(1)), call);
+    lval* formals = lval_add(lval_add(lval_qexpr(), lval_sym("f")),
+                             lval_sym("x"));
+    lval_delete(builtin_fun(e, lval_add(lval_add(lval_sexpr(), formals),
+                                        body)));
+
+    int old = lval_set_max_depth(200);
+    lval* k = lval_sym("f");
+    lval* f = lenv_get(e, k);
+    lval* result = lval_call(e, f, lval_add(lval_sexpr(), lval_num(0)));
+    mu_assert(result->type == LVAL_ERR,
+              "Unbounded recursion should stop with an error");
+    lval_delete(result);
+    lval_set_max_depth(old);
+
+    lval_delete(f);
+    lval_delete(k);
+    lenv_delete(e);
+}
+
+MU_TEST(test_lval_lambda_deep_body) {
+    lenv* e = lenv_new();
+    lenv_add_builtins(e);
+
+    // (\ {x} {{...{x}...}}) nested past the limit
+    lval* body = lval_add(lval_qexpr(), lval_sym("x"));
+    for (int i = 0; i < LVAL_MAX_DEPTH + 10; i++) {
+        body = lval_add(lval_qexpr(), body);
+    }
+    lval* formals = lval_add(lval_qexpr(), lval_sym("x"));
+    lval* result = builtin_lambda(e, lval_add(lval_add(lval_sexpr(), formals),
+                                              lval_copy(body)));
+    mu_assert(result->type == LVAL_ERR,
+              "A lambda body nested past the limit should be an error");
+    lval_delete(result);
+
+    // (fun {f x} {...}) with the same body
+    formals = lval_add(lval_add(lval_qexpr(), lval_sym("f")), lval_sym("x"));
+    result = builtin_fun(e, lval_add(lval_add(lval_sexpr(), formals), body));
+    mu_assert(result->type == LVAL_ERR,
+              "fun with a body nested past the limit should be an error");
+    lval_delete(result);
+    lval* k = lval_sym("f");
+    result = lenv_get(e, k);
+    mu_assert(result->type == LVAL_ERR,
+              "fun should not bind a function it failed to make");
+    lval_delete(result);
+
+    lval_delete(k);
+    lenv_delete(e);
+}
+
+MU_TEST_SUITE(lval_depth_suite) {
+    MU_RUN_TEST(test_lval_deep_lists);
+    MU_RUN_TEST(test_lval_eval_deep_nesting);
+    MU_RUN_TEST(test_lval_call_depth_limit);
+    MU_RUN_TEST(test_lval_lambda_deep_body);
+}
+
+MU_TEST_SUITE(lval_const_suite) {
+    MU_RUN_TEST(test_lval_defconst_rejects_rebinding);
+    MU_RUN_TEST(test_lval_lambda_inlines_consts);
+    MU_RUN_TEST(test_lval_defconst_in_sandbox);
 }
 
 int main() {
     MU_RUN_SUITE(builtin_suite);
     MU_RUN_SUITE(lval_copy_suite);
+    MU_RUN_SUITE(lval_list_suite);
+    MU_RUN_SUITE(lval_cons_list_suite);
+    MU_RUN_SUITE(lval_resolve_suite);
+    MU_RUN_SUITE(lval_const_suite);
+    MU_RUN_SUITE(lval_depth_suite);
     MU_REPORT();
     MU_RETURN_VALUE();
 }